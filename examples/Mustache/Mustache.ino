@@ -17,10 +17,21 @@ class index {
 public:
   static constexpr char *filename = "index.mustache"; // with .mustache ext
   static const char *content() {
-    return "<!doctype html><title>{{title}}</title>\n";
+    return "<!doctype html>{{> header}}\n"
+           "<table>{{#sensors}}<tr><td>{{name}}</td><td>{{value}}</td></tr>"
+           "{{/sensors}}</table>{{^sensors}}No sensors{{/sensors}}\n";
   }
 };
 
+// Included by {{> header}}
+class header {
+public:
+  static constexpr char *filename = "header.mustache";
+  static const char *content() { return "<title>{{title}}</title>"; }
+};
+
+const char *sensorNames[] = {"temperature", "humidity"};
+
 void setup() {
   LOG_SETUP();
 
@@ -32,11 +43,22 @@ void setup() {
   app.set("view engine", "mustache");
   app.set("views", __dirname + "/views");
 
+  mustache::partial(File{header::filename, header::content});
+
+  // rows of the {{#sensors}} section, generated while rendering
+  mustache::list(F("sensors"), [](const size_t index, locals_t &item) {
+    if (index >= 2)
+      return false;
+    item[F("name")] = sensorNames[index];
+    item[F("value")] = analogRead(index);
+    return true;
+  });
+
   app.get(F("/"), [](request &req, response &res, const NextCallback next) {
     locals_t locals;
     locals[F("title")] = F("hello world!");
     File file{index::filename, index::content};
-    res.render(file, locals);
+    res.render(file, std::move(locals));
   });
 
   app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
@@ -0,0 +1,46 @@
+// #define LOGGER Serial
+// #define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+
+// #define PLATFORM ESP32
+#define PLATFORM ESP32_W5500
+
+#include <Express.h>
+using namespace EXPRESS_NAMESPACE;
+
+#include "ethernet_setup.h"
+
+EXPRESS_CREATE_INSTANCE();
+
+// All files packed back to back in one (flash) blob. For real sites, generate
+// this from a directory with extras/bundler/bundle.py
+static const uint8_t data[] PROGMEM =
+    "<!doctype html><link rel=stylesheet href=style.css><h1>Hello</h1>"
+    "h1{color:teal}";
+
+// path, offset, length, MIME type, etag
+static const Asset assets[] = {
+    {"/index.html", 0, 65, "text/html", "\"1-b5c1\""},
+    {"/style.css", 65, 14, "text/css", "\"1-09e2\""},
+};
+
+static const AssetBundle bundle{data, assets, 2};
+
+void setup() {
+  LOG_SETUP();
+
+  ethernet_setup();
+
+  Options options;
+  options.maxAge = 24 * 60 * 60 * 1000; // one day, in ms
+
+  // serves / (index.html) and /style.css, other requests fall through
+  app.use(express::Static(bundle, options));
+
+  app.get(F("/hello"), [](request &req, response &res, const NextCallback next) {
+    res.send(F("Hello World!"));
+  });
+
+  app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
+}
+
+void loop() { app.run(); }
@@ -11,13 +11,36 @@ using namespace EXPRESS_NAMESPACE;
 
 EXPRESS_CREATE_INSTANCE();
 
+// The representations of "/", best match for the Accept header wins.
+static const Format formats[] = {
+    {"html",
+     [](request &req, response &res) {
+       res.status(HttpStatus::OK).send(F("<ul><li>Tobi</li><li>Loki</li></ul>"));
+     }},
+    {"text",
+     [](request &req, response &res) {
+       res.status(HttpStatus::OK).send(F(" - Tobi\n - Loki\n"));
+     }},
+    {"json",
+     [](request &req, response &res) {
+       res.status(HttpStatus::OK).send(F("[\"Tobi\",\"Loki\"]"));
+     }},
+};
+
 void setup() {
   LOG_SETUP();
 
   ethernet_setup();
 
   app.get(F("/"), [](request &req, response &res, const NextCallback next) {
-    res.status(HttpStatus::OK).send(F("Hello World!"));
+    res.format(formats);
+  });
+
+  app.post(F("/"), [](request &req, response &res, const NextCallback next) {
+    if (req.is(F("json")) == "")
+      res.status(HttpStatus::UNSUPPORTED_MEDIA);
+    else
+      res.status(HttpStatus::OK).send(req.body);
   });
 
   app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
@@ -0,0 +1,51 @@
+// #define LOGGER Serial
+// #define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+
+// #define PLATFORM ESP32
+#define PLATFORM ESP32_W5500
+
+#include <Express.h>
+using namespace EXPRESS_NAMESPACE;
+
+#include "ethernet_setup.h"
+
+EXPRESS_CREATE_INSTANCE();
+
+void setup() {
+  LOG_SETUP();
+
+  ethernet_setup();
+
+  // signed cookies are verified with this secret
+  app.set(F("cookie secret"), F("my secret"));
+
+  app.get(F("/"), [](request &req, response &res, const NextCallback next) {
+    if (req.cookies.getSigned(F("remember")) != "")
+      res.status(HttpStatus::OK)
+          .send(F("Remembered :). Click to <a href=\"/forget\">forget</a>!"));
+    else
+      res.status(HttpStatus::OK)
+          .send(F("<a href=\"/remember\">Remember me</a>"));
+  });
+
+  app.get(F("/remember"),
+          [](request &req, response &res, const NextCallback next) {
+            CookieOptions options;
+            options.maxAge = 60 * 1000;
+            options.httpOnly = true;
+            options.sign = true;
+
+            res.cookie(F("remember"), F("1"), options);
+            res.set(F("Location"), F("/")).status(HttpStatus::REDIRECT);
+          });
+
+  app.get(F("/forget"),
+          [](request &req, response &res, const NextCallback next) {
+            res.clearCookie(F("remember"));
+            res.set(F("Location"), F("/")).status(HttpStatus::REDIRECT);
+          });
+
+  app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
+}
+
+void loop() { app.run(); }
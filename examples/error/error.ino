@@ -38,16 +38,20 @@ void setup() {
   ethernet_setup();
 
   app.get(F("/"), [](request &req, response &res, const NextCallback next) {
-    // Caught and passed down to the errorHandler middleware
-    throw new Error("something broke!");
+    // Passed down to the errorHandler middleware. next() copies the message
+    // (up to 63 characters), so the error can live on the stack
+    Error error("something broke!");
+    next(&error);
   });
 
   app.get(F("/next"), [](request &req, response &res, const NextCallback next) {
-    // We can also pass exceptions to next()
-    // The reason for process.nextTick() is to show that
-    // next() can be called inside an async operation,
-    // in real life it can be a DB read or HTTP request.
-    next(new Error("something else broke!"));
+    // next() returns, the error handlers run after this middleware: return
+    // right away, unless there is something left to clean up
+    if (!req.get(F("x-token")).length()) {
+      Error error("something else broke!");
+      return next(&error);
+    }
+    res.send(F("ok"));
   });
 
   // Attach the first Error handling Middleware
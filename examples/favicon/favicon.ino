@@ -35,12 +35,11 @@ void setup() {
   app.get(F("/favicon.ico"),
           [](request &req, response &res, const NextCallback next) {
             res.status(HttpStatus::OK);
-            res.set("Content-Length", String(favicon->length));
             res.set("Content-Type", "image/x-icon");
             //      res.set("Cache-Control", "public, max-age=2592000");
             //      res.set("Expires", new Date(Date.now() +
             //      2592000000).toUTCString());
-            res.end(favicon);
+            res.end(favicon); // binary, sets Content-Length
           });
 
   app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
@@ -0,0 +1,49 @@
+// #define LOGGER Serial
+// #define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+
+// #define PLATFORM ESP32
+#define PLATFORM ESP32_W5500
+
+#include <Express.h>
+using namespace EXPRESS_NAMESPACE;
+
+#include <middlewares/session.h>
+
+#include "ethernet_setup.h"
+
+EXPRESS_CREATE_INSTANCE();
+
+void setup() {
+  LOG_SETUP();
+
+  ethernet_setup();
+
+  // the session ID cookie is signed with this secret
+  app.set(F("cookie secret"), F("keyboard cat"));
+
+  // at most 8 sessions of 64 bytes each, idle sessions expire after 10 minutes
+  SessionOptions options;
+  options.maxSessions = 8;
+  options.sessionSize = 64;
+  options.maxAge = 10 * 60 * 1000;
+  app.use(session(options));
+
+  app.get(F("/"), [](request &req, response &res, const NextCallback next) {
+    auto views = req.session->get(F("views")).toInt() + 1;
+    req.session->set(F("views"), String(views));
+
+    res.status(HttpStatus::OK)
+        .send(String(F("viewed ")) + views + F(" times. <a href=\"/logout\">Logout</a>"));
+  });
+
+  app.get(F("/logout"),
+          [](request &req, response &res, const NextCallback next) {
+            req.session->destroy();
+            res.clearCookie(F("sid"));
+            res.set(F("Location"), F("/")).status(HttpStatus::REDIRECT);
+          });
+
+  app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
+}
+
+void loop() { app.run(); }
@@ -0,0 +1,231 @@
+/// @brief Host-side microbenchmarks of the request hot path: parsing,
+/// routing, url decoding, range parsing, mustache rendering and response
+/// serialization. Every benchmark reports the time and the number of heap
+/// allocations per operation.
+///
+///     make -C extras/bench run
+///     ./build/bench [filter]
+///
+/// Only benchmarks whose name contains filter are run.
+
+#include "Express.h"
+USING_NAMESPACE_EXPRESS
+
+#include "middlewares/mustache.h"
+
+#include <atomic>
+#include <new>
+
+// ---------------------------------------------------------------------------
+// allocation counting
+
+namespace {
+std::atomic<size_t> allocations{0};
+}
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return malloc(size ? size : 1);
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// ---------------------------------------------------------------------------
+// harness
+
+namespace {
+
+const char *filter = nullptr;
+
+/// @brief keeps the optimizer from dropping a result
+template <typename T> void keep(T &&value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+/// @brief Runs op in batches, doubling the batch until one takes at least
+/// 200 ms, and reports the last batch.
+template <typename Op> void bench(const char *name, Op op) {
+  if (filter && !strstr(name, filter))
+    return;
+
+  using clock = std::chrono::steady_clock;
+  const auto minimum = std::chrono::milliseconds(200);
+
+  op(); // warm up, fills caches that live for the lifetime of the app
+
+  for (size_t iterations = 1;; iterations *= 2) {
+    auto allocationsBefore = allocations.load();
+    auto start = clock::now();
+    for (size_t i = 0; i < iterations; i++)
+      op();
+    auto elapsed = clock::now() - start;
+    auto allocated = allocations.load() - allocationsBefore;
+
+    if (elapsed >= minimum || iterations >= (size_t(1) << 30)) {
+      auto ns = std::chrono::duration<double, std::nano>(elapsed).count();
+      printf("%-32s %12zu %12.1f ns/op %8.2f allocs/op\n", name, iterations,
+             ns / iterations, double(allocated) / iterations);
+      return;
+    }
+  }
+}
+
+/// @brief A Print that drops everything
+class NullPrint : public Print {
+public:
+  size_t bytes = 0;
+  size_t write(uint8_t) override { return ++bytes, 1; }
+  size_t write(const uint8_t *, size_t n) override { return bytes += n, n; }
+};
+
+const char getRequest[] =
+    "GET /api/users/42/posts?sort=desc&page=2&q=hello%20world HTTP/1.1\r\n"
+    "Host: 192.168.1.10\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: theme=dark; lang=en\r\n"
+    "\r\n";
+
+const char postBody[] = "{\"name\":\"lathoub\",\"role\":\"admin\",\"active\":true}";
+
+// the Content-Length is taken from postBody
+const std::string postRequest = std::string("POST /api/users HTTP/1.1\r\n"
+                                            "Host: 192.168.1.10\r\n"
+                                            "Content-Type: application/json\r\n"
+                                            "Content-Length: ") +
+                                std::to_string(sizeof postBody - 1) +
+                                "\r\n\r\n" + postBody;
+
+const char *view() {
+  return "<!doctype html><html><head><title>{{title}}</title></head><body>\n"
+         "<h1>{{title}}</h1>\n"
+         "{{#user}}<p>Signed in as {{user}}</p>{{/user}}\n"
+         "{{^user}}<p>Not signed in</p>{{/user}}\n"
+         "<ul>{{#items}}<li>{{name}}: {{value}}</li>{{/items}}</ul>\n"
+         "<p>{{{footer}}}</p></body></html>\n";
+}
+
+bool items(const size_t index, locals_t &item) {
+  static const char *names[] = {"temperature", "humidity", "pressure",
+                                "wind <speed>"};
+  if (index >= 4)
+    return false;
+  item[F("name")] = names[index];
+  item[F("value")] = String(int(index * 17 + 3));
+  return true;
+}
+
+void handler(_Request &, _Response &res, const NextCallback) {
+  res.status(HttpStatus::OK);
+}
+
+/// @brief routes n "/r<i>/:id" handlers on router, the request for the last
+/// one walks all of them
+void addRoutes(_Router &router, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    router.get(String("/r") + i + "/:id", handler);
+}
+
+} // namespace
+
+EXPRESS_CREATE_INSTANCE();
+
+int main(int argc, char *argv[]) {
+  if (argc > 1)
+    filter = argv[1];
+
+  printf("%-32s %12s %15s %18s\n", "benchmark", "iterations", "time",
+         "allocations");
+
+  EthernetClient client;
+
+  bench("parse/get", [&] {
+    client.replay(getRequest, sizeof getRequest - 1);
+    _Request req(app, client);
+    keep(req);
+  });
+
+  bench("parse/post-json", [&] {
+    client.replay(postRequest);
+    _Request req(app, client);
+    keep(req);
+  });
+
+  for (size_t n : {10, 100, 1000}) {
+    auto &router = express::Router();
+    addRoutes(router, n);
+
+    String request = String("GET /r") + (n - 1) + "/42 HTTP/1.1\r\n\r\n";
+    client.replay(request.c_str(), request.length());
+    _Request req(app, client);
+
+    char name[32];
+    snprintf(name, sizeof name, "route/%zu", n);
+    bench(name, [&] {
+      _Response res(app, client, req);
+      req.route = nullptr;
+      req.params.clear();
+      router.dispatch(req, res);
+      keep(res);
+    });
+  }
+
+  bench("urlDecode", [] {
+    auto decoded = _Request::urlDecode(
+        F("caf%C3%A9+au+lait%21%20and%20a%20croissant%2C+please"));
+    keep(decoded);
+  });
+
+  bench("rangeParse", [] {
+    auto range = _Request::rangeParse(F("bytes=0-499,1000-1499,4000-"), 8192);
+    keep(range);
+  });
+
+  {
+    mustache::list(F("items"), items);
+    locals_t locals;
+    locals[F("title")] = F("Weather & <stuff>");
+    locals[F("user")] = F("lathoub");
+    locals[F("footer")] = F("<em>served by Express</em>");
+    NullPrint out;
+    const auto viewLength = strlen(view());
+
+    bench("mustache/render", [&] {
+      mustache::renderFile(out, Locals(locals), nullptr, view(), viewLength);
+    });
+  }
+
+  {
+    const char request[] = "GET / HTTP/1.1\r\n\r\n";
+    client.replay(request, sizeof request - 1);
+    _Request req(app, client);
+    String body(F("{\"temperature\":21.5,\"humidity\":43,\"ok\":true}"));
+
+    bench("send/json", [&] {
+      _Response res(app, client, req);
+      res.set(F("Content-Type"), F("application/json"));
+      res.status(HttpStatus::OK).send(body);
+      res.send();
+    });
+  }
+
+  bench("run/get", [&] {
+    client.replay(getRequest, sizeof getRequest - 1);
+    app.run(client);
+  });
+}
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""Packs a directory of web assets into a header for the Express Static()
+middleware.
+
+    python3 bundle.py data/www src/www.h --name www --gzip
+
+The generated header contains one binary-safe PROGMEM blob with every file,
+an Asset table (path, offset, length, MIME type, ETag and, with --gzip, a
+gzip variant when it is smaller), and the precomputed hash index, so
+Static() does no work at startup or per request besides a lookup:
+
+    #include <Express.h>
+    using namespace EXPRESS_NAMESPACE;
+    #include "www.h"
+
+    www::use(app);          // or app.use(express::Static(www::bundle));
+"""
+
+import argparse
+import gzip
+import hashlib
+import mimetypes
+import os
+import re
+import sys
+
+# mimetypes depends on the host, pin the ones that matter for web assets
+MIME_TYPES = {
+    ".html": "text/html",
+    ".htm": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".mjs": "application/javascript",
+    ".json": "application/json",
+    ".txt": "text/plain",
+    ".xml": "application/xml",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".jpeg": "image/jpeg",
+    ".gif": "image/gif",
+    ".ico": "image/x-icon",
+    ".webp": "image/webp",
+    ".woff": "font/woff",
+    ".woff2": "font/woff2",
+    ".wasm": "application/wasm",
+    ".bin": "application/octet-stream",
+}
+
+# already compressed, gzip will not help
+NO_GZIP = {".png", ".jpg", ".jpeg", ".gif", ".ico", ".webp", ".woff",
+           ".woff2", ".gz", ".zip"}
+
+
+def fnv1a(data, h=2166136261):
+    """Must match AssetIndex::hash in src/Bundle.hpp"""
+    for b in data:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def mime_type(path):
+    ext = os.path.splitext(path)[1].lower()
+    if ext in MIME_TYPES:
+        return MIME_TYPES[ext]
+    return mimetypes.guess_type(path)[0] or "application/octet-stream"
+
+
+def etag(content):
+    return '"%x-%s"' % (len(content), hashlib.sha1(content).hexdigest()[:16])
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def collect(root, dotfiles):
+    files = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        for filename in sorted(filenames):
+            full = os.path.join(dirpath, filename)
+            path = "/" + os.path.relpath(full, root).replace(os.sep, "/")
+            if not dotfiles and "/." in path:
+                continue
+            files.append((path, full))
+    return files
+
+
+def build_index(paths):
+    size = 4
+    while size < len(paths) * 2:
+        size <<= 1
+    slots = [0] * size
+    for i, path in enumerate(paths):
+        slot = fnv1a(path.encode()) & (size - 1)
+        while slots[slot]:
+            slot = (slot + 1) & (size - 1)
+        slots[slot] = i + 1
+    return slots
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="directory with the web assets")
+    parser.add_argument("output", help="header file to generate")
+    parser.add_argument("--name", help="C++ namespace (default: output name)")
+    parser.add_argument("--gzip", action="store_true",
+                        help="add gzip variants when they are smaller")
+    parser.add_argument("--dotfiles", action="store_true",
+                        help="include files and directories starting with .")
+    args = parser.parse_args()
+
+    name = args.name or os.path.splitext(os.path.basename(args.output))[0]
+    name = re.sub(r"\W", "_", name)
+
+    files = collect(args.input, args.dotfiles)
+    if not files:
+        sys.exit("no files found in " + args.input)
+    if len(files) > 32767:
+        sys.exit("too many files for a 16 bit index")
+
+    blob = bytearray()
+    assets = []
+    for path, full in files:
+        with open(full, "rb") as f:
+            content = f.read()
+
+        entry = {"path": path, "offset": len(blob), "length": len(content),
+                 "mime": mime_type(path), "etag": etag(content)}
+        blob += content
+
+        ext = os.path.splitext(path)[1].lower()
+        if args.gzip and ext not in NO_GZIP:
+            # mtime=0 keeps the output reproducible
+            compressed = gzip.compress(content, 9, mtime=0)
+            if len(compressed) < len(content):
+                entry["gzip"] = (len(blob), len(compressed), etag(compressed))
+                blob += compressed
+
+        assets.append(entry)
+
+    index = build_index([a["path"] for a in assets])
+
+    out = []
+    out.append("// Generated by extras/bundler/bundle.py from %s, do not edit."
+               % args.input.replace("\\", "/"))
+    out.append("")
+    out.append("#pragma once")
+    out.append("")
+    out.append("namespace %s {" % name)
+    out.append("")
+    out.append("using namespace EXPRESS_NAMESPACE;")
+    out.append("")
+    out.append("static const uint8_t data[%d] PROGMEM = {" % len(blob))
+    for i in range(0, len(blob), 16):
+        out.append("    " + ", ".join("0x%02x" % b for b in blob[i:i + 16])
+                   + ",")
+    out.append("};")
+    out.append("")
+    out.append("// path, offset, length, MIME type, etag"
+               + (", gzip offset, gzip length, gzip etag" if args.gzip else ""))
+    out.append("static const Asset assets[%d] = {" % len(assets))
+    for a in assets:
+        fields = [c_string(a["path"]), str(a["offset"]), str(a["length"]),
+                  c_string(a["mime"]), c_string(a["etag"])]
+        if "gzip" in a:
+            offset, length, tag = a["gzip"]
+            fields += [str(offset), str(length), c_string(tag)]
+        out.append("    {%s}," % ", ".join(fields))
+    out.append("};")
+    out.append("")
+    out.append("static const uint16_t index[%d] = {" % len(index))
+    for i in range(0, len(index), 16):
+        out.append("    " + ", ".join(str(s) for s in index[i:i + 16]) + ",")
+    out.append("};")
+    out.append("")
+    out.append("static const AssetBundle bundle{data, assets, %d, index, %d};"
+               % (len(assets), len(index)))
+    out.append("")
+    out.append("/// @brief serves the bundled assets on app")
+    out.append("inline void use(_Express &app, const Options &options = "
+               "Options()) {")
+    out.append("  app.use(_Express::Static(bundle, options));")
+    out.append("}")
+    out.append("")
+    out.append("} // namespace %s" % name)
+    out.append("")
+
+    with open(args.output, "w", newline="\n") as f:
+        f.write("\n".join(out))
+
+    print("%s: %d files, %d bytes" % (args.output, len(assets), len(blob)))
+
+
+if __name__ == "__main__":
+    main()
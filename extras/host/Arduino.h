@@ -0,0 +1,375 @@
+/// @brief Minimal Arduino core for building the library on a Linux host
+/// (benchmarks, load tests, traffic replay). Only what the library uses is
+/// here. String is backed by std::string, so its allocation pattern is close
+/// to, but not the same as, the ESP32 core's String (both have a small
+/// string buffer, of different sizes).
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#include <thread>
+
+#ifndef ARDUINO
+#define ARDUINO 10819
+#endif
+
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define FPSTR(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define PROGMEM
+#define PSTR(s) (s)
+
+inline unsigned long millis() {
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+inline unsigned long micros() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+inline void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+inline void yield() {}
+inline long random(long lo, long hi) { return lo + rand() % (hi - lo); }
+inline long random(long hi) { return rand() % hi; }
+inline void randomSeed(unsigned long seed) { srand(seed); }
+inline int analogRead(int) { return 0; }
+inline uint32_t esp_random() { return (uint32_t)rand(); }
+
+class String {
+private:
+  std::string s_;
+  bool valid_ = true;
+
+public:
+  String() {}
+  String(const char *c) {
+    if (c)
+      s_ = c;
+    else
+      valid_ = false;
+  }
+  String(const __FlashStringHelper *c)
+      : String(reinterpret_cast<const char *>(c)) {}
+  String(const std::string &s) : s_(s) {}
+  String(std::string &&s) : s_(std::move(s)) {}
+  String(char c) : s_(1, c) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+  String(long long v) : s_(std::to_string(v)) {}
+  String(unsigned long long v) : s_(std::to_string(v)) {}
+  String(double v, int decimals = 2) {
+    char buffer[64];
+    snprintf(buffer, sizeof buffer, "%.*f", decimals, v);
+    s_ = buffer;
+  }
+
+  unsigned int length() const { return s_.size(); }
+  const char *c_str() const { return s_.c_str(); }
+  char *begin() { return &s_[0]; }
+  const char *begin() const { return s_.c_str(); }
+  const char *end() const { return s_.c_str() + s_.size(); }
+  bool reserve(unsigned n) {
+    s_.reserve(n);
+    return true;
+  }
+
+  char charAt(unsigned i) const { return i < s_.size() ? s_[i] : 0; }
+  char operator[](unsigned i) const { return charAt(i); }
+  char &operator[](unsigned i) {
+    static char dummy;
+    return i < s_.size() ? s_[i] : dummy;
+  }
+  void setCharAt(unsigned i, char c) {
+    if (i < s_.size())
+      s_[i] = c;
+  }
+
+  int indexOf(char c, unsigned from = 0) const {
+    auto p = s_.find(c, from);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  int indexOf(const String &c, unsigned from = 0) const {
+    auto p = s_.find(c.s_, from);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  int lastIndexOf(char c) const {
+    auto p = s_.rfind(c);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  String substring(unsigned b) const {
+    return b >= s_.size() ? String("") : String(s_.substr(b));
+  }
+  String substring(unsigned b, unsigned e) const {
+    if (e > s_.size())
+      e = s_.size();
+    if (b > e)
+      std::swap(b, e);
+    return String(s_.substr(b, e - b));
+  }
+
+  void toLowerCase() {
+    for (auto &c : s_)
+      c = tolower(c);
+  }
+  void toUpperCase() {
+    for (auto &c : s_)
+      c = toupper(c);
+  }
+  void trim() {
+    auto b = s_.find_first_not_of(" \t\r\n");
+    auto e = s_.find_last_not_of(" \t\r\n");
+    s_ = b == std::string::npos ? "" : s_.substr(b, e - b + 1);
+  }
+  long toInt() const { return atol(s_.c_str()); }
+
+  bool equals(const String &o) const { return s_ == o.s_; }
+  bool equalsIgnoreCase(const String &o) const {
+    return s_.size() == o.s_.size() &&
+           strncasecmp(s_.c_str(), o.s_.c_str(), s_.size()) == 0;
+  }
+  bool startsWith(const String &o) const {
+    return s_.compare(0, o.s_.size(), o.s_) == 0;
+  }
+  bool endsWith(const String &o) const {
+    return s_.size() >= o.s_.size() &&
+           s_.compare(s_.size() - o.s_.size(), o.s_.size(), o.s_) == 0;
+  }
+
+  bool concat(const char *c, unsigned n) {
+    s_.append(c, n);
+    return true;
+  }
+  bool concat(const String &o) {
+    s_ += o.s_;
+    return true;
+  }
+  bool concat(const char *c) {
+    if (c)
+      s_ += c;
+    return true;
+  }
+  bool concat(char c) {
+    s_ += c;
+    return true;
+  }
+  template <typename T> bool concat(const T &v) { return concat(String(v)); }
+
+  void remove(unsigned i) {
+    if (i < s_.size())
+      s_.erase(i);
+  }
+  void remove(unsigned i, unsigned n) {
+    if (i < s_.size())
+      s_.erase(i, n);
+  }
+  void replace(const String &a, const String &b) {
+    size_t p = 0;
+    while ((p = s_.find(a.s_, p)) != std::string::npos) {
+      s_.replace(p, a.s_.size(), b.s_);
+      p += b.s_.size();
+    }
+  }
+
+  template <typename T> String &operator+=(const T &v) {
+    concat(v);
+    return *this;
+  }
+
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator==(const char *o) const {
+    return o ? s_ == o : !valid_ || s_.empty();
+  }
+  bool operator!=(const String &o) const { return !(*this == o); }
+  bool operator!=(const char *o) const { return !(*this == o); }
+  bool operator<(const String &o) const { return s_ < o.s_; }
+  explicit operator bool() const { return valid_; }
+
+  void getBytes(unsigned char *buffer, unsigned n) const {
+    memcpy(buffer, s_.data(), std::min<size_t>(n, s_.size()));
+  }
+};
+
+template <typename T> inline String operator+(const String &a, const T &b) {
+  String r(a);
+  r += b;
+  return r;
+}
+inline String operator+(const char *a, const String &b) {
+  String r(a);
+  r += b;
+  return r;
+}
+inline String operator+(const __FlashStringHelper *a, const String &b) {
+  String r(a);
+  r += b;
+  return r;
+}
+
+class Print;
+
+class Printable {
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print &p) const = 0;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t n) {
+    size_t i = 0;
+    while (i < n && write(buffer[i]))
+      i++;
+    return i;
+  }
+  size_t write(const char *buffer, size_t n) {
+    return write(reinterpret_cast<const uint8_t *>(buffer), n);
+  }
+  size_t write(const char *s) { return s ? write(s, strlen(s)) : 0; }
+
+  size_t print(const String &s) { return write(s.c_str(), s.length()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(const __FlashStringHelper *s) {
+    return write(reinterpret_cast<const char *>(s));
+  }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(long long v) { return print(String(v)); }
+  size_t print(unsigned long long v) { return print(String(v)); }
+  size_t print(double v) { return print(String(v)); }
+  size_t print(const Printable &v) { return v.printTo(*this); }
+
+  template <typename T> size_t println(const T &v) {
+    auto n = print(v);
+    return n + println();
+  }
+  size_t println() { return write("\r\n", 2); }
+
+  virtual void flush() {}
+};
+
+class IPAddress : public Printable {
+private:
+  uint8_t bytes_[4]{};
+
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes_{a, b, c, d} {}
+  IPAddress(uint32_t v) { memcpy(bytes_, &v, 4); }
+  operator uint32_t() const {
+    uint32_t v;
+    memcpy(&v, bytes_, 4);
+    return v;
+  }
+  uint8_t operator[](int i) const { return bytes_[i]; }
+  size_t printTo(Print &p) const override { return p.print(toString()); }
+  String toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof buffer, "%u.%u.%u.%u", bytes_[0], bytes_[1],
+             bytes_[2], bytes_[3]);
+    return String(buffer);
+  }
+};
+inline String operator+(const String &a, const IPAddress &b) {
+  return a + b.toString();
+}
+
+class Stream : public Print {
+protected:
+  unsigned long timeout_ = 1000;
+
+  /// @brief the next byte, waiting up to timeout_ for it
+  int timedRead() {
+    auto c = read();
+    if (c >= 0)
+      return c; // keep the clock out of the common case
+    auto start = millis();
+    do {
+      yield();
+      if ((c = read()) >= 0)
+        return c;
+    } while (millis() - start < timeout_);
+    return -1;
+  }
+
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  virtual int read(uint8_t *buffer, size_t n) {
+    size_t i = 0;
+    while (i < n && available())
+      buffer[i++] = read();
+    return i;
+  }
+  size_t readBytes(uint8_t *buffer, size_t n) { return read(buffer, n); }
+  size_t readBytes(char *buffer, size_t n) {
+    return read(reinterpret_cast<uint8_t *>(buffer), n);
+  }
+  String readStringUntil(char terminator) {
+    std::string s;
+    for (int c; (c = timedRead()) >= 0 && c != terminator;)
+      s += (char)c;
+    return String(std::move(s));
+  }
+  void setTimeout(unsigned long timeout) { timeout_ = timeout; }
+};
+
+class Client : public Stream {
+public:
+  virtual uint8_t connected() = 0;
+  virtual void stop() = 0;
+  virtual operator bool() = 0;
+  virtual IPAddress remoteIP() { return IPAddress(127, 0, 0, 1); }
+  using Print::write;
+  using Stream::read;
+};
+
+/// @brief Log output. Discarded unless EXPRESS_HOST_LOG is set in the
+/// environment, formatting still happens so its cost stays measurable.
+class HardwareSerial : public Stream {
+private:
+  FILE *out_ = nullptr;
+
+public:
+  void begin(unsigned long) {}
+  void output(FILE *out) { out_ = out; }
+
+  size_t write(uint8_t c) override {
+    if (out_)
+      fputc(c, out_);
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t n) override {
+    if (out_)
+      fwrite(buffer, 1, n, out_);
+    return n;
+  }
+  using Print::write;
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  operator bool() { return true; }
+};
+extern HardwareSerial Serial;
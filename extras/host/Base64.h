@@ -0,0 +1,35 @@
+/// @brief Host stand-in for the ESP32 core's base64 helper.
+#pragma once
+
+#include "Arduino.h"
+
+namespace base64 {
+
+inline String encode(const String &in) {
+  static const char table[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  std::string out;
+  auto s = reinterpret_cast<const uint8_t *>(in.c_str());
+  size_t n = in.length();
+  size_t i = 0;
+  for (; i + 2 < n; i += 3) {
+    uint32_t v = s[i] << 16 | s[i + 1] << 8 | s[i + 2];
+    out += table[v >> 18];
+    out += table[(v >> 12) & 63];
+    out += table[(v >> 6) & 63];
+    out += table[v & 63];
+  }
+  if (i < n) {
+    uint32_t v = s[i] << 16;
+    if (i + 1 < n)
+      v |= s[i + 1] << 8;
+    out += table[v >> 18];
+    out += table[(v >> 12) & 63];
+    out += i + 1 < n ? table[(v >> 6) & 63] : '=';
+    out += '=';
+  }
+  return String(std::move(out));
+}
+
+} // namespace base64
@@ -0,0 +1,219 @@
+/// @brief Host stand-in for the Ethernet library. An EthernetClient either
+/// replays a canned request from memory, so the library can be driven
+/// without a network (the client itself never allocates), or wraps a TCP
+/// connection accepted by EthernetServer, which listens on localhost only.
+#pragma once
+
+#include "Arduino.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class EthernetClient : public Client {
+private:
+  // replay
+  const uint8_t *in_ = nullptr;
+  size_t length_ = 0;
+  size_t pos_ = 0;
+  std::string *out_ = nullptr;
+  size_t written_ = 0;
+  bool open_ = false;
+
+  // socket, -1 when replaying
+  int fd_ = -1;
+
+  /// @brief tops up in_ from the socket, waiting up to timeout ms
+  bool fill(int timeout) {
+    if (pos_ < length_)
+      return true;
+    if (fd_ < 0)
+      return false;
+
+    pollfd p{fd_, POLLIN, 0};
+    if (poll(&p, 1, timeout) <= 0)
+      return false;
+
+    auto n = recv(fd_, rx_, sizeof rx_, 0);
+    if (n <= 0) {
+      open_ = false;
+      return false;
+    }
+    in_ = rx_;
+    length_ = n;
+    pos_ = 0;
+    return true;
+  }
+
+  uint8_t rx_[1460];
+
+public:
+  IPAddress ip{127, 0, 0, 1};
+
+  EthernetClient() {}
+
+  /// @brief wraps a connected socket
+  explicit EthernetClient(int fd) : open_(true), fd_(fd) {
+    sockaddr_in peer{};
+    socklen_t size = sizeof peer;
+    if (getpeername(fd, reinterpret_cast<sockaddr *>(&peer), &size) == 0)
+      ip = IPAddress(peer.sin_addr.s_addr);
+  }
+
+  EthernetClient(const EthernetClient &other) { *this = other; }
+  EthernetClient &operator=(const EthernetClient &other) {
+    memcpy(rx_, other.rx_, sizeof rx_);
+    in_ = other.in_ == other.rx_ ? rx_ : other.in_;
+    length_ = other.length_;
+    pos_ = other.pos_;
+    out_ = other.out_;
+    written_ = other.written_;
+    open_ = other.open_;
+    fd_ = other.fd_;
+    ip = other.ip;
+    return *this;
+  }
+
+  /// @brief (Re)starts the connection with data as the inbound bytes. data
+  /// is referenced, not copied.
+  void replay(const char *data, size_t length) {
+    in_ = reinterpret_cast<const uint8_t *>(data);
+    length_ = length;
+    pos_ = 0;
+    written_ = 0;
+    open_ = true;
+  }
+  void replay(const std::string &data) { replay(data.data(), data.size()); }
+
+  /// @brief Appends everything written to out, nullptr discards it.
+  void capture(std::string *out) { out_ = out; }
+
+  /// @brief bytes written since replay()
+  size_t written() const { return written_; }
+
+  IPAddress remoteIP() override { return ip; }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t n) override {
+    if (out_)
+      out_->append(reinterpret_cast<const char *>(buffer), n);
+    written_ += n;
+
+    if (fd_ < 0)
+      return n;
+
+    size_t sent = 0;
+    while (sent < n) {
+      auto r = send(fd_, buffer + sent, n - sent, MSG_NOSIGNAL);
+      if (r <= 0) {
+        open_ = false;
+        break;
+      }
+      sent += r;
+    }
+    return sent;
+  }
+  using Print::write;
+
+  int available() override {
+    if (pos_ < length_ || fd_ < 0)
+      return length_ - pos_;
+
+    int pending = 0;
+    ioctl(fd_, FIONREAD, &pending);
+    return pending;
+  }
+
+  int read() override {
+    if (!fill(0))
+      return -1;
+    return in_[pos_++];
+  }
+
+  int read(uint8_t *buffer, size_t n) override {
+    if (!fill(0))
+      return -1;
+    n = std::min(n, length_ - pos_);
+    memcpy(buffer, in_ + pos_, n);
+    pos_ += n;
+    return n;
+  }
+
+  int peek() override { return fill(0) ? in_[pos_] : -1; }
+
+  uint8_t connected() override {
+    if (!open_)
+      return false;
+    if (fd_ < 0)
+      return pos_ < length_;
+    if (pos_ < length_)
+      return true;
+
+    // open until the peer closes its side
+    char c;
+    auto n = recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+  }
+
+  void stop() override {
+    open_ = false;
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+    length_ = pos_ = 0;
+  }
+
+  operator bool() override { return open_; }
+
+  void setConnectionTimeout(int) {}
+};
+
+class EthernetServer {
+private:
+  uint16_t port_;
+  int fd_ = -1;
+
+public:
+  EthernetServer(uint16_t port) : port_(port) {}
+
+  void begin() {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port_);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd_, reinterpret_cast<sockaddr *>(&address), sizeof address) ||
+        listen(fd_, 128)) {
+      perror("EthernetServer");
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  /// @brief the next pending connection, waits up to 10 ms for one
+  EthernetClient available() {
+    if (fd_ < 0)
+      return EthernetClient();
+
+    pollfd p{fd_, POLLIN, 0};
+    if (poll(&p, 1, 10) <= 0)
+      return EthernetClient();
+
+    auto client = accept(fd_, nullptr, nullptr);
+    if (client < 0)
+      return EthernetClient();
+
+    int on = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    return EthernetClient(client);
+  }
+};
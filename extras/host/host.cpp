@@ -0,0 +1,13 @@
+#include "Arduino.h"
+
+HardwareSerial Serial;
+
+namespace {
+/// @brief EXPRESS_HOST_LOG=1 sends the library's log output to stderr
+struct LogOutput {
+  LogOutput() {
+    if (getenv("EXPRESS_HOST_LOG"))
+      Serial.output(stderr);
+  }
+} logOutput;
+} // namespace
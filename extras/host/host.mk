@@ -0,0 +1,43 @@
+# Builds the library for a Linux host, against the Arduino stand-ins in this
+# directory. Include from a tool's Makefile; it provides $(HOST_OBJS) (the
+# library plus the host core) and the flags to compile against them.
+
+HOST_DIR := $(dir $(lastword $(MAKEFILE_LIST)))
+LIB_DIR := $(HOST_DIR)../../src
+BUILD_DIR ?= build
+
+CXX ?= g++
+OPTIMIZE ?= -O2 -g
+HOST_CPPFLAGS := -DESP32 -DARDUINO=10819 -I$(HOST_DIR) -I$(LIB_DIR)
+HOST_CXXFLAGS := -std=gnu++11 $(OPTIMIZE)
+
+# the library is written for the ESP32 toolchain (gnu++11 with a few C++17
+# constructs); the other warnings turned off here are about older code
+HOST_WARNINGS ?= -Wall -Wextra -Wno-c++17-extensions -Wno-reorder \
+                 -Wno-sign-compare -Wno-empty-body -Wno-unused-function
+
+# for apps: route handlers take (req, res, next) whether they use them or not
+APP_WARNINGS = $(HOST_WARNINGS) -Wno-unused-parameter
+
+LIB_SRCS := $(wildcard $(LIB_DIR)/*.cpp $(LIB_DIR)/utility/*.cpp)
+HOST_HEADERS := $(wildcard $(HOST_DIR)*.h $(HOST_DIR)mbedtls/*.h)
+HOST_OBJS := $(patsubst $(LIB_DIR)/%.cpp,$(BUILD_DIR)/lib/%.o,$(LIB_SRCS)) \
+             $(BUILD_DIR)/lib/host.o
+
+$(BUILD_DIR)/lib/%.o: $(LIB_DIR)/%.cpp $(wildcard $(LIB_DIR)/*.h $(LIB_DIR)/*.hpp $(LIB_DIR)/utility/*.h) $(HOST_HEADERS)
+	@mkdir -p $(dir $@)
+	$(CXX) $(HOST_CXXFLAGS) $(HOST_CPPFLAGS) $(EXTRA_FLAGS) $(HOST_WARNINGS) -c $< -o $@
+
+# stubs and callbacks that do not use all of their parameters (yet)
+$(BUILD_DIR)/lib/Express.o $(BUILD_DIR)/lib/response.o: HOST_WARNINGS += -Wno-unused-parameter
+
+$(BUILD_DIR)/lib/host.o: $(HOST_DIR)host.cpp $(HOST_HEADERS)
+	@mkdir -p $(dir $@)
+	$(CXX) $(HOST_CXXFLAGS) $(HOST_CPPFLAGS) $(EXTRA_FLAGS) -c $< -o $@
+
+# entry point for sketch style programs (setup() and loop())
+HOST_MAIN := $(BUILD_DIR)/lib/main.o
+
+$(HOST_MAIN): $(HOST_DIR)main.cpp
+	@mkdir -p $(dir $@)
+	$(CXX) $(HOST_CXXFLAGS) $(HOST_CPPFLAGS) $(EXTRA_FLAGS) -c $< -o $@
@@ -0,0 +1,11 @@
+#include "Arduino.h"
+
+/// @brief Runs a sketch: setup() once, then loop() forever
+void setup();
+void loop();
+
+int main() {
+  setup();
+  for (;;)
+    loop();
+}
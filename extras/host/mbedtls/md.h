@@ -0,0 +1,177 @@
+/// @brief Host stand-in for the subset of the mbedtls message digest API the
+/// library uses (SHA-256 and HMAC-SHA256), self-contained so host builds need
+/// no crypto library.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+typedef enum { MBEDTLS_MD_NONE = 0, MBEDTLS_MD_SHA256 = 6 } mbedtls_md_type_t;
+
+typedef struct {
+  mbedtls_md_type_t type;
+} mbedtls_md_info_t;
+
+struct mbedtls_sha256_state {
+  uint32_t h[8];
+  uint8_t block[64];
+  size_t used;
+  uint64_t total;
+};
+
+typedef struct {
+  mbedtls_sha256_state sha;
+  uint8_t opad[64];
+} mbedtls_md_context_t;
+
+namespace mbedtls_host {
+
+inline uint32_t ror(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline void compress(mbedtls_sha256_state &s, const uint8_t *p) {
+  static const uint32_t k[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+      0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+      0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+      0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+      0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+      0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++)
+    w[i] = uint32_t(p[i * 4]) << 24 | uint32_t(p[i * 4 + 1]) << 16 |
+           uint32_t(p[i * 4 + 2]) << 8 | p[i * 4 + 3];
+  for (int i = 16; i < 64; i++) {
+    auto s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    auto s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t v[8];
+  memcpy(v, s.h, sizeof v);
+  for (int i = 0; i < 64; i++) {
+    auto t1 = v[7] + (ror(v[4], 6) ^ ror(v[4], 11) ^ ror(v[4], 25)) +
+              ((v[4] & v[5]) ^ (~v[4] & v[6])) + k[i] + w[i];
+    auto t2 = (ror(v[0], 2) ^ ror(v[0], 13) ^ ror(v[0], 22)) +
+              ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+    memmove(v + 1, v, 7 * sizeof(uint32_t));
+    v[4] += t1;
+    v[0] = t1 + t2;
+  }
+  for (int i = 0; i < 8; i++)
+    s.h[i] += v[i];
+}
+
+inline void starts(mbedtls_sha256_state &s) {
+  static const uint32_t iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                 0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                 0x1f83d9ab, 0x5be0cd19};
+  memcpy(s.h, iv, sizeof iv);
+  s.used = 0;
+  s.total = 0;
+}
+
+inline void update(mbedtls_sha256_state &s, const uint8_t *p, size_t n) {
+  s.total += n;
+  while (n > 0) {
+    auto chunk = 64 - s.used < n ? 64 - s.used : n;
+    memcpy(s.block + s.used, p, chunk);
+    s.used += chunk;
+    p += chunk;
+    n -= chunk;
+    if (s.used == 64) {
+      compress(s, s.block);
+      s.used = 0;
+    }
+  }
+}
+
+inline void finish(mbedtls_sha256_state &s, uint8_t *out) {
+  auto bits = s.total * 8;
+  uint8_t pad = 0x80;
+  update(s, &pad, 1);
+  pad = 0;
+  while (s.used != 56)
+    update(s, &pad, 1);
+  uint8_t length[8];
+  for (int i = 0; i < 8; i++)
+    length[i] = uint8_t(bits >> (56 - i * 8));
+  update(s, length, 8);
+  for (int i = 0; i < 8; i++) {
+    out[i * 4] = uint8_t(s.h[i] >> 24);
+    out[i * 4 + 1] = uint8_t(s.h[i] >> 16);
+    out[i * 4 + 2] = uint8_t(s.h[i] >> 8);
+    out[i * 4 + 3] = uint8_t(s.h[i]);
+  }
+}
+
+} // namespace mbedtls_host
+
+inline const mbedtls_md_info_t *
+mbedtls_md_info_from_type(mbedtls_md_type_t type) {
+  static const mbedtls_md_info_t sha256{MBEDTLS_MD_SHA256};
+  return type == MBEDTLS_MD_SHA256 ? &sha256 : nullptr;
+}
+
+inline void mbedtls_md_init(mbedtls_md_context_t *ctx) {
+  memset(ctx, 0, sizeof *ctx);
+}
+inline void mbedtls_md_free(mbedtls_md_context_t *ctx) {
+  memset(ctx, 0, sizeof *ctx);
+}
+inline int mbedtls_md_setup(mbedtls_md_context_t *,
+                            const mbedtls_md_info_t *info, int) {
+  return info ? 0 : -1;
+}
+
+inline int mbedtls_md(const mbedtls_md_info_t *info, const unsigned char *in,
+                      size_t n, unsigned char *out) {
+  if (!info)
+    return -1;
+  mbedtls_sha256_state s;
+  mbedtls_host::starts(s);
+  mbedtls_host::update(s, in, n);
+  mbedtls_host::finish(s, out);
+  return 0;
+}
+
+inline int mbedtls_md_hmac_starts(mbedtls_md_context_t *ctx,
+                                  const unsigned char *key, size_t n) {
+  uint8_t block[64]{};
+  if (n > 64)
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key, n, block);
+  else
+    memcpy(block, key, n);
+
+  uint8_t ipad[64];
+  for (int i = 0; i < 64; i++) {
+    ipad[i] = block[i] ^ 0x36;
+    ctx->opad[i] = block[i] ^ 0x5c;
+  }
+  mbedtls_host::starts(ctx->sha);
+  mbedtls_host::update(ctx->sha, ipad, 64);
+  return 0;
+}
+
+inline int mbedtls_md_hmac_update(mbedtls_md_context_t *ctx,
+                                  const unsigned char *in, size_t n) {
+  mbedtls_host::update(ctx->sha, in, n);
+  return 0;
+}
+
+inline int mbedtls_md_hmac_finish(mbedtls_md_context_t *ctx,
+                                  unsigned char *out) {
+  uint8_t inner[32];
+  mbedtls_host::finish(ctx->sha, inner);
+  mbedtls_host::starts(ctx->sha);
+  mbedtls_host::update(ctx->sha, ctx->opad, 64);
+  mbedtls_host::update(ctx->sha, inner, 32);
+  mbedtls_host::finish(ctx->sha, out);
+  return 0;
+}
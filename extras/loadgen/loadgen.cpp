@@ -0,0 +1,598 @@
+/// @brief HTTP load generator for an app running on this machine (see
+/// server.cpp for one). Keeps N connections busy with a weighted mix of
+/// requests and reports throughput and latency percentiles, from a log-linear
+/// (HDR style) histogram with 128 buckets per power of two (< 1% error).
+///
+///     ./build/loadgen [-c connections] [-n requests | -d seconds] [-k]
+///                     [-p port] [-m mixfile] [-t timeout ms]
+///
+/// -k reuses connections (keep-alive) for as long as the server allows it,
+/// a server answering with "Connection: close" gets a new connection for
+/// the next request. Without -k every request opens its own connection.
+///
+/// A mix file has one request type per line: a weight, the method, the path
+/// and optionally the body or range to send:
+///
+///     # weight method path [json=<bytes> | upload=<bytes> | range=<a>-<b>]
+///     50 GET  /
+///     20 GET  /api/items/42
+///     10 POST /api/echo json=256
+///     10 GET  /file range=0-4095
+///     10 POST /upload upload=16384
+///
+/// which is also the mix used without -m. Connections only ever go to
+/// 127.0.0.1.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t elapsedMicros(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               since)
+      .count();
+}
+
+/// @brief Log-linear histogram of microseconds: values below 256 have their
+/// own bucket, above that every power of two is split in 128 buckets.
+class Histogram {
+private:
+  static const int subBits = 7;
+  static const uint64_t subCount = 1 << subBits;
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_ = 0;
+  uint64_t min_ = UINT64_MAX;
+  uint64_t max_ = 0;
+  double sum_ = 0;
+
+  static size_t index(uint64_t value) {
+    if (value < 2 * subCount)
+      return value;
+    int power = 63 - __builtin_clzll(value); // >= subBits + 1
+    int shift = power - subBits;
+    return 2 * subCount + (power - subBits - 1) * subCount +
+           ((value >> shift) - subCount);
+  }
+
+  /// @brief the highest value that lands in bucket i
+  static uint64_t highest(size_t i) {
+    if (i < 2 * subCount)
+      return i;
+    auto power = (i - 2 * subCount) / subCount + subBits + 1;
+    auto shift = power - subBits;
+    auto sub = (i - 2 * subCount) % subCount + subCount;
+    return ((sub + 1) << shift) - 1;
+  }
+
+public:
+  Histogram() : counts_(index(UINT64_C(1) << 40) + 1) {}
+
+  void record(uint64_t value) {
+    auto i = index(value);
+    if (i >= counts_.size())
+      i = counts_.size() - 1;
+    counts_[i]++;
+    total_++;
+    sum_ += value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  uint64_t count() const { return total_; }
+  uint64_t min() const { return total_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  double mean() const { return total_ ? sum_ / total_ : 0; }
+
+  /// @brief the value at or below which percentile % of the values are
+  uint64_t percentile(double percentile) const {
+    if (total_ == 0)
+      return 0;
+    auto rank = uint64_t(std::ceil(percentile / 100 * total_));
+    if (rank == 0)
+      rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+      seen += counts_[i];
+      if (seen >= rank)
+        return std::min(highest(i), max_);
+    }
+    return max_;
+  }
+};
+
+/// @brief One line of the mix: the request bytes are built once
+struct RequestType {
+  unsigned weight;
+  std::string label;
+  std::string bytes;
+  Histogram latency;
+  uint64_t statuses[6]; // 1xx..5xx, [0] = other
+};
+
+struct Options {
+  int connections = 8;
+  uint64_t requests = 10000;
+  double seconds = 0;
+  bool keepAlive = false;
+  uint16_t port = 8080;
+  const char *mix = nullptr;
+  int timeout = 5000;
+};
+
+const char defaultMix[] = "50 GET  /\n"
+                          "20 GET  /api/items/42\n"
+                          "10 POST /api/echo json=256\n"
+                          "10 GET  /file range=0-4095\n"
+                          "10 POST /upload upload=16384\n";
+
+bool parseMix(std::istream &in, const Options &options,
+              std::vector<RequestType> &types) {
+  std::string line;
+  for (int number = 1; std::getline(in, line); number++) {
+    auto hash = line.find('#');
+    if (hash != std::string::npos)
+      line.erase(hash);
+
+    std::istringstream fields(line);
+    unsigned weight;
+    std::string method, path, extra;
+    if (!(fields >> weight))
+      continue;
+    if (!(fields >> method >> path)) {
+      fprintf(stderr, "mix line %d: expected <weight> <method> <path>\n",
+              number);
+      return false;
+    }
+    fields >> extra;
+
+    std::string headers, body;
+    size_t bytes = 0;
+    unsigned long first = 0, last = 0;
+    if (extra.compare(0, 5, "json=") == 0) {
+      bytes = strtoul(extra.c_str() + 5, nullptr, 10);
+      body = "{\"data\":\"";
+      while (body.size() + 2 < bytes)
+        body += char('a' + body.size() % 26);
+      body += "\"}";
+      headers = "Content-Type: application/json\r\n";
+    } else if (extra.compare(0, 7, "upload=") == 0) {
+      bytes = strtoul(extra.c_str() + 7, nullptr, 10);
+      body.resize(bytes);
+      for (size_t i = 0; i < bytes; i++)
+        body[i] = char(i * 31);
+      headers = "Content-Type: application/octet-stream\r\n";
+    } else if (sscanf(extra.c_str(), "range=%lu-%lu", &first, &last) == 2) {
+      headers = "Range: bytes=" + std::to_string(first) + "-" +
+                std::to_string(last) + "\r\n";
+    } else if (!extra.empty()) {
+      fprintf(stderr, "mix line %d: unknown option %s\n", number,
+              extra.c_str());
+      return false;
+    }
+    if (!body.empty())
+      headers += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+
+    RequestType type;
+    type.weight = weight;
+    type.label = method + " " + path + (extra.empty() ? "" : " " + extra);
+    type.bytes = method + " " + path + " HTTP/1.1\r\nHost: 127.0.0.1:" +
+                 std::to_string(options.port) + "\r\nConnection: " +
+                 (options.keepAlive ? "keep-alive" : "close") + "\r\n" +
+                 headers + "\r\n" + body;
+    memset(type.statuses, 0, sizeof type.statuses);
+    types.push_back(std::move(type));
+  }
+
+  if (types.empty()) {
+    fprintf(stderr, "the mix has no requests\n");
+    return false;
+  }
+  return true;
+}
+
+struct Connection {
+  int fd = -1;
+  RequestType *type = nullptr;
+  size_t sent = 0;
+  std::string received;
+  size_t headerEnd = 0;    // 0 until the headers are in
+  long contentLength = -1; // -1: until the server closes
+  bool serverCloses = false;
+  int status = 0;
+  bool reused = false; // the request went out on a kept-alive connection
+  Clock::time_point start;
+};
+
+struct Totals {
+  Histogram latency;
+  uint64_t completed = 0;
+  uint64_t started = 0;
+  uint64_t bytesIn = 0;
+  uint64_t bytesOut = 0;
+  uint64_t connects = 0;
+  uint64_t connectErrors = 0;
+  uint64_t readErrors = 0;
+  uint64_t timeouts = 0;
+  uint64_t retries = 0;
+};
+
+class LoadGenerator {
+private:
+  const Options &options_;
+  std::vector<RequestType> &types_;
+  unsigned totalWeight_ = 0;
+  uint64_t random_ = 0x9e3779b97f4a7c15ull;
+
+  int epoll_ = -1;
+  std::vector<Connection> connections_;
+  sockaddr_in address_{};
+  Clock::time_point begin_;
+
+public:
+  Totals totals;
+  double seconds = 0;
+
+  LoadGenerator(const Options &options, std::vector<RequestType> &types)
+      : options_(options), types_(types), connections_(options.connections) {
+    for (auto &type : types_)
+      totalWeight_ += type.weight;
+    address_.sin_family = AF_INET;
+    address_.sin_port = htons(options.port);
+    address_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+
+  void run() {
+    epoll_ = epoll_create1(0);
+    begin_ = Clock::now();
+
+    for (auto &connection : connections_)
+      next(connection);
+
+    epoll_event events[64];
+    while (busy()) {
+      auto n = epoll_wait(epoll_, events, 64, 100);
+      for (int i = 0; i < n; i++) {
+        auto &connection = *static_cast<Connection *>(events[i].data.ptr);
+        if (events[i].events & (EPOLLOUT | EPOLLERR))
+          send(connection);
+        if (connection.fd >= 0 && events[i].events & (EPOLLIN | EPOLLHUP))
+          receive(connection);
+      }
+      expire();
+    }
+
+    seconds = elapsedMicros(begin_) / 1e6;
+    close(epoll_);
+  }
+
+private:
+  auto busy() -> bool {
+    for (auto &connection : connections_)
+      if (connection.type)
+        return true;
+    return false;
+  }
+
+  auto done() -> bool {
+    if (options_.seconds > 0)
+      return elapsedMicros(begin_) >= options_.seconds * 1e6;
+    return totals.started >= options_.requests;
+  }
+
+  auto pick() -> RequestType * {
+    // xorshift64, the same sequence every run
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+    auto ticket = unsigned(random_ % totalWeight_);
+    for (auto &type : types_) {
+      if (ticket < type.weight)
+        return &type;
+      ticket -= type.weight;
+    }
+    return &types_.back();
+  }
+
+  /// @brief starts the next request on connection, if there is one
+  void next(Connection &connection) {
+    if (done()) {
+      drop(connection);
+      connection.type = nullptr;
+      return;
+    }
+
+    totals.started++;
+    connection.type = pick();
+    connection.start = Clock::now();
+    begin(connection);
+  }
+
+  /// @brief (re)sends connection's request, connecting first when needed
+  void begin(Connection &connection) {
+    connection.sent = 0;
+    connection.received.clear();
+    connection.headerEnd = 0;
+    connection.contentLength = -1;
+    connection.serverCloses = false;
+    connection.status = 0;
+    connection.reused = connection.fd >= 0;
+
+    if (connection.fd < 0 && !open(connection)) {
+      totals.connectErrors++;
+      next(connection);
+      return;
+    }
+    send(connection);
+  }
+
+  auto open(Connection &connection) -> bool {
+    auto fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+      return false;
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address_),
+                sizeof address_) < 0 &&
+        errno != EINPROGRESS) {
+      close(fd);
+      return false;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLOUT | EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = &connection;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event);
+
+    connection.fd = fd;
+    totals.connects++;
+    return true;
+  }
+
+  void drop(Connection &connection) {
+    if (connection.fd >= 0) {
+      epoll_ctl(epoll_, EPOLL_CTL_DEL, connection.fd, nullptr);
+      close(connection.fd);
+      connection.fd = -1;
+    }
+  }
+
+  void send(Connection &connection) {
+    auto &bytes = connection.type->bytes;
+    while (connection.sent < bytes.size()) {
+      auto n = ::send(connection.fd, bytes.data() + connection.sent,
+                      bytes.size() - connection.sent, MSG_NOSIGNAL);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return; // EPOLLOUT tells when to continue
+      if (n <= 0) {
+        fail(connection, totals.connectErrors);
+        return;
+      }
+      connection.sent += n;
+      totals.bytesOut += n;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = &connection;
+    epoll_ctl(epoll_, EPOLL_CTL_MOD, connection.fd, &event);
+  }
+
+  void receive(Connection &connection) {
+    char buffer[16 * 1024];
+    for (;;) {
+      auto n = recv(connection.fd, buffer, sizeof buffer, 0);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return;
+      if (n <= 0) {
+        closed(connection);
+        return;
+      }
+      totals.bytesIn += n;
+      connection.received.append(buffer, n);
+      if (complete(connection)) {
+        finish(connection);
+        return;
+      }
+    }
+  }
+
+  /// @brief parses the headers once they are in
+  auto complete(Connection &connection) -> bool {
+    auto &received = connection.received;
+    if (connection.headerEnd == 0) {
+      auto end = received.find("\r\n\r\n");
+      if (end == std::string::npos)
+        return false;
+      connection.headerEnd = end + 4;
+      sscanf(received.c_str(), "HTTP/%*d.%*d %d", &connection.status);
+
+      for (auto line = received.find("\r\n"); line < end;) {
+        auto next = received.find("\r\n", line + 2);
+        auto field = received.c_str() + line + 2;
+        if (strncasecmp(field, "content-length:", 15) == 0)
+          connection.contentLength = strtol(field + 15, nullptr, 10);
+        else if (strncasecmp(field, "connection:", 11) == 0)
+          connection.serverCloses =
+              strcasestr(std::string(field, next - line - 2).c_str(),
+                         "close") != nullptr;
+        line = next;
+      }
+    }
+
+    return connection.contentLength >= 0 &&
+           received.size() >= connection.headerEnd + connection.contentLength;
+  }
+
+  /// @brief the server closed the connection
+  void closed(Connection &connection) {
+    // a kept-alive connection closed before any answer: the server had
+    // already given up on it, retry on a new one
+    if (connection.reused && connection.received.empty()) {
+      totals.retries++;
+      drop(connection);
+      begin(connection);
+      return;
+    }
+    if (connection.headerEnd > 0 && connection.contentLength < 0) {
+      finish(connection); // body delimited by the close
+      return;
+    }
+    fail(connection, totals.readErrors);
+  }
+
+  void finish(Connection &connection) {
+    auto latency = elapsedMicros(connection.start);
+    auto &type = *connection.type;
+    type.latency.record(latency);
+    totals.latency.record(latency);
+    totals.completed++;
+
+    auto statusClass = connection.status / 100;
+    type.statuses[statusClass >= 1 && statusClass <= 5 ? statusClass : 0]++;
+
+    if (!options_.keepAlive || connection.serverCloses ||
+        connection.contentLength < 0)
+      drop(connection);
+    next(connection);
+  }
+
+  void fail(Connection &connection, uint64_t &counter) {
+    counter++;
+    drop(connection);
+    next(connection);
+  }
+
+  void expire() {
+    for (auto &connection : connections_)
+      if (connection.type &&
+          elapsedMicros(connection.start) > uint64_t(options_.timeout) * 1000)
+        fail(connection, totals.timeouts);
+  }
+};
+
+void usage() {
+  fprintf(stderr, "usage: loadgen [-c connections] [-n requests | -d seconds] "
+                  "[-k] [-p port] [-m mixfile] [-t timeout ms]\n");
+  exit(2);
+}
+
+void printLatency(const char *indent, const Histogram &h) {
+  printf("%sp50 %llu  p75 %llu  p90 %llu  p99 %llu  p99.9 %llu  p99.99 %llu\n",
+         indent, (unsigned long long)h.percentile(50),
+         (unsigned long long)h.percentile(75),
+         (unsigned long long)h.percentile(90),
+         (unsigned long long)h.percentile(99),
+         (unsigned long long)h.percentile(99.9),
+         (unsigned long long)h.percentile(99.99));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  for (int opt; (opt = getopt(argc, argv, "c:n:d:kp:m:t:h")) != -1;) {
+    switch (opt) {
+    case 'c':
+      options.connections = atoi(optarg);
+      break;
+    case 'n':
+      options.requests = strtoull(optarg, nullptr, 10);
+      break;
+    case 'd':
+      options.seconds = atof(optarg);
+      break;
+    case 'k':
+      options.keepAlive = true;
+      break;
+    case 'p':
+      options.port = atoi(optarg);
+      break;
+    case 'm':
+      options.mix = optarg;
+      break;
+    case 't':
+      options.timeout = atoi(optarg);
+      break;
+    default:
+      usage();
+    }
+  }
+  if (options.connections < 1 || (options.requests == 0 && options.seconds <= 0))
+    usage();
+
+  std::vector<RequestType> types;
+  if (options.mix) {
+    std::ifstream in(options.mix);
+    if (!in) {
+      fprintf(stderr, "cannot open %s\n", options.mix);
+      return 1;
+    }
+    if (!parseMix(in, options, types))
+      return 1;
+  } else {
+    std::istringstream in(defaultMix);
+    parseMix(in, options, types);
+  }
+
+  LoadGenerator generator(options, types);
+  generator.run();
+
+  auto &totals = generator.totals;
+  auto &latency = totals.latency;
+  printf("127.0.0.1:%u, %d connections, %s, %llu requests in %.2f s\n",
+         options.port, options.connections,
+         options.keepAlive ? "keep-alive" : "close",
+         (unsigned long long)totals.completed, generator.seconds);
+  printf("throughput: %.1f req/s, %.2f MiB/s in, %.2f MiB/s out\n",
+         totals.completed / generator.seconds,
+         totals.bytesIn / generator.seconds / (1 << 20),
+         totals.bytesOut / generator.seconds / (1 << 20));
+  printf("latency (us): min %llu  mean %.0f  max %llu\n",
+         (unsigned long long)latency.min(), latency.mean(),
+         (unsigned long long)latency.max());
+  printLatency("  ", latency);
+  printf("connections opened %llu, retried %llu, errors: connect %llu  read "
+         "%llu  timeout %llu\n",
+         (unsigned long long)totals.connects,
+         (unsigned long long)totals.retries,
+         (unsigned long long)totals.connectErrors,
+         (unsigned long long)totals.readErrors,
+         (unsigned long long)totals.timeouts);
+
+  for (auto &type : types) {
+    printf("\n%s: %llu  (1xx %llu 2xx %llu 3xx %llu 4xx %llu 5xx %llu)\n",
+           type.label.c_str(), (unsigned long long)type.latency.count(),
+           (unsigned long long)type.statuses[1],
+           (unsigned long long)type.statuses[2],
+           (unsigned long long)type.statuses[3],
+           (unsigned long long)type.statuses[4],
+           (unsigned long long)type.statuses[5]);
+    printLatency("  ", type.latency);
+  }
+
+  auto failed = totals.connectErrors + totals.readErrors + totals.timeouts;
+  return failed > 0 ? 1 : 0;
+}
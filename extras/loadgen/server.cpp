@@ -0,0 +1,97 @@
+/// @brief The library on the host, serving on localhost for loadgen. Serves
+/// one route per kind of request in the default mix:
+///
+///     GET  /                  a short text body
+///     GET  /api/items/:id     a small JSON body
+///     POST /api/echo          echoes a JSON body (express::json())
+///     GET  /file              64 KiB, honours Range requests
+///     POST /upload            counts an application/octet-stream body
+///                             (express::raw())
+///
+///     PORT=8080 ./build/server
+///
+/// With RECORD=<file> in the environment the traffic it receives is
+/// recorded to file, to be replayed with extras/replay.
+
+#include "Express.h"
+USING_NAMESPACE_EXPRESS
+
+EXPRESS_CREATE_INSTANCE();
+
+namespace {
+
+uint8_t fileData[64 * 1024];
+
+size_t uploaded = 0;
+
+/// @brief
+class FilePrint : public Print {
+public:
+  FILE *file;
+  explicit FilePrint(FILE *file) : file(file) {}
+  size_t write(uint8_t c) override { return fputc(c, file) == EOF ? 0 : 1; }
+  size_t write(const uint8_t *buffer, size_t n) override {
+    return fwrite(buffer, 1, n, file);
+  }
+  void flush() override { fflush(file); }
+};
+
+} // namespace
+
+void setup() {
+  for (size_t i = 0; i < sizeof fileData; i++)
+    fileData[i] = 'a' + i % 26;
+
+  app.get(F("/"), [](request &req, response &res, const NextCallback next) {
+    res.send(F("Hello World!"));
+  });
+
+  app.get(F("/api/items/:id"),
+          [](request &req, response &res, const NextCallback next) {
+            res.set(ContentType, ApplicationJson);
+            res.send(String(F("{\"id\":")) + req.params[F("id")] +
+                     F(",\"name\":\"item\",\"price\":12.5}"));
+          });
+
+  app.post(F("/api/echo"), express::json(),
+           [](request &req, response &res, const NextCallback next) {
+             res.send(req.body);
+           });
+
+  app.get(F("/file"), [](request &req, response &res, const NextCallback next) {
+    File file{F("data.bin"), fileData, sizeof fileData};
+
+    Options options;
+    auto range = req.get(F("range"));
+    if (range.length() > 0)
+      options.headers[F("range")] = range;
+
+    res.sendFile(file, &options);
+  });
+
+  auto &upload = app.post(F("/upload"), express::raw(),
+                          [](request &req, response &res,
+                             const NextCallback next) {
+                            res.send(String(uploaded));
+                            uploaded = 0;
+                          });
+  upload.on(F("data"), [](const Buffer &chunk) { uploaded += chunk.length; });
+
+  if (auto path = getenv("RECORD")) {
+    if (auto file = fopen(path, "wb")) {
+      setvbuf(file, nullptr, _IONBF, 0); // complete up to the last record
+      static FilePrint out(file);
+      static TrafficRecorder recorder(out);
+      app.record(&recorder);
+    } else
+      perror(path);
+  }
+
+  auto port = getenv("PORT") ? atoi(getenv("PORT")) : 8080;
+  app.listen(port, []() {
+    printf("listening on http://127.0.0.1:%u\n", app.port);
+    fflush(stdout);
+  });
+}
+
+void loop() { app.run(); }
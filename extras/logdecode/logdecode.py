@@ -0,0 +1,332 @@
+#!/usr/bin/env python3
+"""Decodes the binary log frames of a device built with LOG_BINARY=1 (or
+after Logger::binary(true)) back into the text the logger would have
+printed. Two steps: generate the table of LOG_x() call sites from the
+sources the firmware was built from, then decode a capture with it:
+
+    python3 logdecode.py table src path/to/sketch -o logtable.json
+    python3 logdecode.py decode logtable.json capture.bin
+    cat /dev/ttyUSB0 | python3 logdecode.py decode logtable.json
+
+Frames only hold the ID of the call site and the arguments that are not
+F() literals, the table has the rest. Bytes that are not part of a frame
+(boot messages, LOG_PLAIN(), ...) are passed through as they are.
+
+Regenerate the table whenever the sources change: the ID of a call site is
+derived from its file name and line (see Logger::site in
+src/utility/logger.h). For a call that spans lines, compilers differ on that
+line: the line of LOG_x or the line of the closing parenthesis. Both are in
+the table.
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+FRAME_MARKER = 0xA5
+
+# Logger::Tag
+FLASH, TEXT, SIGNED, UNSIGNED, FLOAT, CHAR = range(6)
+
+PREFIXES = {
+    "F": "FATAL:   ",
+    "E": "ERROR:   ",
+    "W": "Warning: ",
+    "I": "Info:    ",
+    "N": "Notice:  ",
+    "T": "trace:   ",
+    "V": "verbose: ",
+}
+
+SOURCE_EXTENSIONS = {".c", ".cpp", ".h", ".hpp", ".ino"}
+
+CALL = re.compile(r"\bLOG_([FEWINTV])\s*\(")
+LITERAL = re.compile(r'^F\(\s*((?:"(?:[^"\\]|\\.)*"\s*)+)\)$', re.S)
+STRING = re.compile(r'"((?:[^"\\]|\\.)*)"', re.S)
+
+ESCAPES = {"n": "\n", "r": "\r", "t": "\t", "0": "\0", "\\": "\\",
+           '"': '"', "'": "'", "?": "?", "a": "\a", "b": "\b", "f": "\f",
+           "v": "\v"}
+
+
+def fnv1a(data, h=2166136261):
+    """Must match Logger::hash in src/utility/logger.h"""
+    for b in data:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def site(path, line):
+    """Must match Logger::site in src/utility/logger.h"""
+    h = fnv1a(os.path.basename(path).encode() + b":" +
+              struct.pack("<I", line))
+    return h or 1
+
+
+def unescape(s):
+    out, i = [], 0
+    while i < len(s):
+        c = s[i]
+        if c == "\\" and i + 1 < len(s):
+            e = s[i + 1]
+            if e == "x":
+                m = re.match(r"[0-9a-fA-F]+", s[i + 2:])
+                out.append(chr(int(m.group(0), 16)))
+                i += 2 + len(m.group(0))
+                continue
+            out.append(ESCAPES.get(e, e))
+            i += 2
+            continue
+        out.append(c)
+        i += 1
+    return "".join(out)
+
+
+def strip_comments(code):
+    """Blanks out comments, keeping strings and line numbers."""
+    out, i, n = [], 0, len(code)
+    while i < n:
+        c = code[i]
+        if c in "\"'":
+            j = i + 1
+            while j < n and code[j] != c:
+                j += 2 if code[j] == "\\" else 1
+            out.append(code[i:j + 1])
+            i = j + 1
+        elif code.startswith("//", i):
+            j = code.find("\n", i)
+            j = n if j < 0 else j
+            out.append(" " * (j - i))
+            i = j
+        elif code.startswith("/*", i):
+            j = code.find("*/", i + 2)
+            j = n if j < 0 else j + 2
+            out.append(re.sub(r"[^\n]", " ", code[i:j]))
+            i = j
+        else:
+            out.append(c)
+            i += 1
+    return "".join(out)
+
+
+def arguments(code, start):
+    """Splits the arguments of the call whose '(' is at start. Returns them
+    and the position of the ')'."""
+    args, depth, i, begin = [], 0, start, start + 1
+    while i < len(code):
+        c = code[i]
+        if c in "\"'":
+            j = i + 1
+            while j < len(code) and code[j] != c:
+                j += 2 if code[j] == "\\" else 1
+            i = j
+        elif c in "([{":
+            depth += 1
+        elif c in ")]}":
+            depth -= 1
+            if depth == 0:
+                args.append(code[begin:i].strip())
+                return args, i
+        elif c == "," and depth == 1:
+            args.append(code[begin:i].strip())
+            begin = i + 1
+        i += 1
+    return None, None
+
+
+def scan(path, sites):
+    with open(path, encoding="utf-8", errors="replace") as f:
+        code = strip_comments(f.read())
+
+    for match in CALL.finditer(code):
+        line_start = code.rfind("\n", 0, match.start()) + 1
+        if code[line_start:match.start()].lstrip().startswith("#"):
+            continue  # the macros themselves
+        args, end = arguments(code, match.end() - 1)
+        if args is None:
+            continue
+        line = code.count("\n", 0, match.start()) + 1
+        last = line + code.count("\n", match.start(), end)
+
+        spec = []
+        for arg in args:
+            literal = LITERAL.match(arg)
+            if literal:
+                spec.append({"text": "".join(
+                    unescape(s) for s in STRING.findall(literal.group(1)))})
+            else:
+                if "?" in arg and "F(" in arg:
+                    print(f"{path}:{line}: flash string that is not a literal"
+                          " will not decode, log it as text", file=sys.stderr)
+                spec.append({"expr": " ".join(arg.split())})
+
+        entry = {"file": path, "line": line, "level": match.group(1),
+                 "args": spec}
+        for at in sorted({line, last}):
+            key = str(site(path, at))
+            if key in sites and sites[key] != entry:
+                other = sites[key]
+                print(f"{path}:{at}: same ID as "
+                      f"{other['file']}:{other['line']}", file=sys.stderr)
+            sites[key] = entry
+
+
+def table(options):
+    sites = {}
+    for root in options.paths:
+        if os.path.isfile(root):
+            scan(root, sites)
+            continue
+        for directory, _, files in sorted(os.walk(root)):
+            for name in sorted(files):
+                if os.path.splitext(name)[1] in SOURCE_EXTENSIONS:
+                    scan(os.path.join(directory, name), sites)
+
+    out = open(options.output, "w") if options.output else sys.stdout
+    json.dump({"version": 1, "sites": sites}, out, indent=1, sort_keys=True)
+    out.write("\n")
+    print(f"{len(sites)} call sites", file=sys.stderr)
+
+
+def varint(data, i):
+    value, shift = 0, 0
+    while i < len(data):
+        b = data[i]
+        i += 1
+        value |= (b & 0x7F) << shift
+        if not b & 0x80:
+            return value, i
+        shift += 7
+    raise ValueError
+
+
+def values(data):
+    """Decodes the arguments of a frame, as Logger::flush would print them."""
+    out, i = [], 0
+    while i < len(data):
+        tag = data[i]
+        i += 1
+        if tag == TEXT:
+            n = data[i]
+            if i + 1 + n > len(data):
+                raise ValueError
+            out.append(data[i + 1:i + 1 + n].decode("utf-8", "replace"))
+            i += 1 + n
+        elif tag == SIGNED:
+            v, i = varint(data, i)
+            out.append(str((v >> 1) ^ -(v & 1)))
+        elif tag == UNSIGNED:
+            v, i = varint(data, i)
+            out.append(str(v))
+        elif tag == FLOAT:
+            if i + 8 > len(data):
+                raise ValueError
+            out.append("%.2f" % struct.unpack_from("<d", data, i))
+            i += 8
+        elif tag == CHAR:
+            out.append(chr(data[i]))
+            i += 1
+        else:
+            raise ValueError
+    return out
+
+
+def line(sites, data, show_sites):
+    """The text of the frame in data (after the length), None if it is not
+    one."""
+    key = struct.unpack_from("<I", data)[0]
+    try:
+        args = values(data[4:])
+    except (ValueError, IndexError):
+        return None
+
+    if key == 0:
+        if len(args) != 1:
+            return None
+        return f"{PREFIXES['W']}{args[0]} log records dropped"
+
+    entry = sites.get(str(key))
+    if entry is None:
+        return None
+    runtime = [a for a in entry["args"] if "expr" in a]
+    if len(args) > len(runtime):
+        return None
+
+    parts = []
+    for spec in entry["args"]:
+        if "text" in spec:
+            parts.append(spec["text"])
+        elif args:
+            parts.append(args.pop(0))
+    text = PREFIXES[entry["level"]] + " ".join(parts)
+    if show_sites:
+        text += f"  ({entry['file']}:{entry['line']})"
+    return text
+
+
+def decode(options):
+    with open(options.table) as f:
+        sites = json.load(f)["sites"]
+
+    source = open(options.log, "rb") if options.log else sys.stdin.buffer
+    out = sys.stdout.buffer
+    pending = b""
+    while True:
+        chunk = source.read1(4096) if hasattr(source, "read1") else \
+            source.read(4096)
+        pending += chunk
+        i = 0
+        while i < len(pending):
+            if pending[i] != FRAME_MARKER:
+                j = pending.find(bytes([FRAME_MARKER]), i)
+                j = len(pending) if j < 0 else j
+                out.write(pending[i:j])
+                i = j
+                continue
+            if i + 2 > len(pending) or i + 2 + pending[i + 1] > len(pending):
+                if chunk:
+                    break  # wait for the rest of the frame
+                out.write(pending[i:i + 1])
+                i += 1
+                continue
+            length = pending[i + 1]
+            text = line(sites, pending[i + 2:i + 2 + length],
+                        options.sites) if length >= 4 else None
+            if text is None:
+                out.write(pending[i:i + 1])  # not a frame after all
+                i += 1
+                continue
+            out.write(text.encode() + b"\r\n")
+            i += 2 + length
+        pending = pending[i:]
+        out.flush()
+        if not chunk:
+            break
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    p = commands.add_parser("table", help="generate the table of call sites")
+    p.add_argument("paths", nargs="+", help="source files or directories")
+    p.add_argument("-o", "--output", help="table to write (default stdout)")
+    p.set_defaults(run=table)
+
+    p = commands.add_parser("decode", help="decode a binary log")
+    p.add_argument("table", help="table generated by the table command")
+    p.add_argument("log", nargs="?", help="binary log (default stdin)")
+    p.add_argument("--sites", action="store_true",
+                   help="append file:line of the call site to every line")
+    p.set_defaults(run=decode)
+
+    options = parser.parse_args()
+    options.run(options)
+
+
+if __name__ == "__main__":
+    main()
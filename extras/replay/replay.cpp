@@ -0,0 +1,256 @@
+/// @brief Replays a traffic log recorded with app.record() (see
+/// src/Traffic.hpp) through an app built for the host. Every recorded
+/// connection is fed to app.run() by a client that hands out the recorded
+/// bytes no sooner than they originally arrived, so slow or bursty clients
+/// behave as they did in the field.
+///
+///     make APP=path/to/app.cpp        (default: ../loadgen/server.cpp)
+///     ./build/replay [-s speed] [-v] traffic.bin
+///
+/// The app is a sketch: its setup() registers the routes, its loop() is not
+/// used. -s 2 replays twice as fast, -s 0 as fast as possible (all bytes of
+/// a connection are there at once, connections follow each other without
+/// pause). -v prints the status line of every response.
+
+#include "Express.h"
+USING_NAMESPACE_EXPRESS
+
+#include <fstream>
+#include <iterator>
+
+extern _Express app;
+
+void setup();
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// @brief bytes read in one go, at (microseconds since the connection opened)
+struct Chunk {
+  uint64_t at;
+  std::string bytes;
+};
+
+struct Connection {
+  uint64_t opened; // microseconds since the start of the log
+  std::vector<Chunk> chunks;
+};
+
+auto readVarint(const std::string &log, size_t &offset, uint64_t &value)
+    -> bool {
+  value = 0;
+  for (int shift = 0; offset < log.size() && shift < 64; shift += 7) {
+    auto byte = uint8_t(log[offset++]);
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+/// @brief Splits the log into connections. Data without an Open first (the
+/// ring dropped it) starts a connection of its own.
+auto parse(const std::string &log, std::vector<Connection> &connections)
+    -> bool {
+  if (log.compare(0, 4, "EXTR") != 0 || log.size() < 5 ||
+      uint8_t(log[4]) != TrafficRecorder::version) {
+    fprintf(stderr, "not a version %u traffic log\n",
+            TrafficRecorder::version);
+    return false;
+  }
+
+  uint64_t now = 0;
+  bool open = false;
+  for (size_t offset = 5; offset < log.size();) {
+    auto type = uint8_t(log[offset++]);
+    uint64_t delta, length;
+    if (!readVarint(log, offset, delta) || !readVarint(log, offset, length) ||
+        offset + length > log.size()) {
+      fprintf(stderr, "truncated record at %zu, stopping there\n", offset);
+      break;
+    }
+    now += delta;
+
+    switch (type) {
+    case TrafficRecorder::Open:
+      connections.push_back(Connection{now, {}});
+      open = true;
+      break;
+    case TrafficRecorder::Data:
+      if (!open) {
+        connections.push_back(Connection{now, {}});
+        open = true;
+      }
+      connections.back().chunks.push_back(
+          Chunk{now - connections.back().opened, log.substr(offset, length)});
+      break;
+    case TrafficRecorder::Close:
+      open = false;
+      break;
+    default:
+      fprintf(stderr, "unknown record type %u at %zu\n", type, offset);
+      return false;
+    }
+    offset += length;
+  }
+  return true;
+}
+
+/// @brief Hands out the bytes of a recorded connection as they arrived,
+/// time scaled by 1 / speed.
+class ReplayClient : public EthernetClient {
+private:
+  const Connection &connection_;
+  double speed_;
+  Clock::time_point opened_;
+  size_t chunk_ = 0;
+  size_t pos_ = 0;
+  bool stopped_ = false;
+
+  /// @brief
+  /// @return true when chunk i is due
+  bool arrived(size_t i) {
+    if (i >= connection_.chunks.size())
+      return false;
+    if (speed_ <= 0)
+      return true;
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                       Clock::now() - opened_)
+                       .count();
+    return elapsed * speed_ >= connection_.chunks[i].at;
+  }
+
+  /// @brief moves to the next chunk once the current one is read
+  bool due() {
+    while (chunk_ < connection_.chunks.size() &&
+           pos_ == connection_.chunks[chunk_].bytes.size()) {
+      chunk_++;
+      pos_ = 0;
+    }
+    return arrived(chunk_);
+  }
+
+public:
+  std::string out;
+
+  ReplayClient(const Connection &connection, double speed)
+      : connection_(connection), speed_(speed), opened_(Clock::now()) {}
+
+  int available() override {
+    if (!due())
+      return 0;
+    int n = 0;
+    for (auto i = chunk_; arrived(i); i++)
+      n += connection_.chunks[i].bytes.size() - (i == chunk_ ? pos_ : 0);
+    return n;
+  }
+
+  int read() override {
+    if (!due())
+      return -1;
+    return uint8_t(connection_.chunks[chunk_].bytes[pos_++]);
+  }
+
+  int read(uint8_t *buffer, size_t size) override {
+    if (!due())
+      return -1;
+    auto &bytes = connection_.chunks[chunk_].bytes;
+    size = std::min(size, bytes.size() - pos_);
+    memcpy(buffer, bytes.data() + pos_, size);
+    pos_ += size;
+    return size;
+  }
+
+  int peek() override {
+    return due() ? uint8_t(connection_.chunks[chunk_].bytes[pos_]) : -1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override {
+    out.append(reinterpret_cast<const char *>(buffer), size);
+    return size;
+  }
+  using EthernetClient::write;
+
+  uint8_t connected() override {
+    return !stopped_ && (due() || chunk_ < connection_.chunks.size());
+  }
+  void stop() override { stopped_ = true; }
+  operator bool() override { return !stopped_; }
+};
+
+void usage() {
+  fprintf(stderr, "usage: replay [-s speed] [-v] traffic.bin\n");
+  exit(2);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  double speed = 1;
+  bool verbose = false;
+  for (int opt; (opt = getopt(argc, argv, "s:v")) != -1;) {
+    switch (opt) {
+    case 's':
+      speed = atof(optarg);
+      break;
+    case 'v':
+      verbose = true;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (optind + 1 != argc)
+    usage();
+
+  std::ifstream in(argv[optind], std::ios::binary);
+  if (!in) {
+    perror(argv[optind]);
+    return 1;
+  }
+  std::string log((std::istreambuf_iterator<char>(in)),
+                  std::istreambuf_iterator<char>());
+
+  std::vector<Connection> connections;
+  if (!parse(log, connections))
+    return 1;
+
+  setup();
+
+  size_t bytesIn = 0, bytesOut = 0;
+  auto start = Clock::now();
+  for (auto &connection : connections) {
+    if (speed > 0 && !connections.empty()) {
+      auto due = std::chrono::microseconds(
+          uint64_t((connection.opened - connections.front().opened) / speed));
+      std::this_thread::sleep_until(start + due);
+    }
+
+    auto begin = Clock::now();
+    ReplayClient client(connection, speed);
+    app.run(client);
+
+    for (auto &chunk : connection.chunks)
+      bytesIn += chunk.bytes.size();
+    bytesOut += client.out.size();
+
+    if (verbose) {
+      auto took = std::chrono::duration_cast<std::chrono::microseconds>(
+                      Clock::now() - begin)
+                      .count();
+      auto line = client.out.substr(0, client.out.find("\r\n"));
+      printf("%10.3f ms  %8lld us  %s\n", connection.opened / 1000.0,
+             (long long)took, line.empty() ? "(no response)" : line.c_str());
+    }
+  }
+  auto elapsed =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  auto span = connections.empty()
+                  ? 0
+                  : connections.back().opened - connections.front().opened;
+  printf("%zu connections, %zu bytes in, %zu bytes out, replayed in %.3f s "
+         "(recorded over %.3f s, speed %g)\n",
+         connections.size(), bytesIn, bytesOut, elapsed, span / 1e6, speed);
+}
@@ -10,14 +10,57 @@ public:
                       const String &encoding = F("base64")) {
     Buffer *buffer = new Buffer();
 
-    buffer->length = data.length();
-    memcpy(buffer->buffer, data.c_str(), data.length());
+    if (encoding.equalsIgnoreCase(F("base64"))) {
+      buffer->length = decodeBase64(data.c_str(), data.length(),
+                                    buffer->buffer, sizeof(buffer->buffer));
+    } else {
+      buffer->length = (data.length() < sizeof(buffer->buffer))
+                           ? data.length()
+                           : sizeof(buffer->buffer);
+      memcpy(buffer->buffer, data.c_str(), buffer->length);
+    }
 
-    LOG_V(F("encoded length"), buffer->length);
+    LOG_V(F("encoded length"), data.length(), F("decoded length"),
+          buffer->length);
 
     return buffer;
   }
 
+  /// @brief Decodes base64 text (padding and whitespace are skipped)
+  /// @return the number of bytes written to out
+  static size_t decodeBase64(const char *in, size_t len, byte *out,
+                             size_t capacity) {
+    uint32_t bits = 0;
+    int count = 0;
+    size_t length = 0;
+
+    for (size_t i = 0; i < len && length < capacity; i++) {
+      auto c = in[i];
+      int value;
+      if (c >= 'A' && c <= 'Z')
+        value = c - 'A';
+      else if (c >= 'a' && c <= 'z')
+        value = c - 'a' + 26;
+      else if (c >= '0' && c <= '9')
+        value = c - '0' + 52;
+      else if (c == '+' || c == '-')
+        value = 62;
+      else if (c == '/' || c == '_')
+        value = 63;
+      else
+        continue;
+
+      bits = (bits << 6) | value;
+      count += 6;
+      if (count >= 8) {
+        count -= 8;
+        out[length++] = static_cast<byte>(bits >> count);
+      }
+    }
+
+    return length;
+  }
+
   String toString() {
     return "AAABAAEAEBAQAAAAAAAoAQAAFgAAACgAAAAQAAAAIAAAAAEABAAAAAAAgAAAAAAAAAA"
            "AAAAAEAAAAAAAAAAAAAAA/"
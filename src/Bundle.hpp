@@ -0,0 +1,113 @@
+#ifndef EXPRESS_STATIC_INSTANCES
+#define EXPRESS_STATIC_INSTANCES 2 // Static() middlewares, each its own bundle
+#endif
+
+/// @brief A single file inside an AssetBundle. The bytes live in the bundle's
+/// data blob at [offset, offset + length). An optional gzip encoded variant
+/// lives at [gzipOffset, gzipOffset + gzipLength). Members left out of a
+/// brace initializer are zero.
+struct Asset {
+  const char *path; // absolute url path, e.g. "/index.html"
+  uint32_t offset;
+  uint32_t length;
+  const char *mime;
+  const char *etag;
+  uint32_t gzipOffset;
+  uint32_t gzipLength; // 0: no gzip variant
+  const char *gzipEtag;
+};
+
+/// @brief A packed set of web assets: one contiguous (flash) blob plus a table
+/// describing where each file starts. index/indexSize are optional: when
+/// present they hold a precomputed open addressing table (slot -> asset
+/// position + 1, 0 = empty), hashed with AssetIndex::hash.
+struct AssetBundle {
+  const uint8_t *data;
+  const Asset *assets;
+  uint16_t count;
+  const uint16_t *index;
+  uint16_t indexSize; // power of 2
+};
+
+/// @brief O(1) path lookup into an AssetBundle.
+class AssetIndex {
+private:
+  const AssetBundle *bundle_ = nullptr;
+
+  /// @brief slots, either the bundle's precomputed table or built here
+  std::vector<uint16_t> slots_{};
+  const uint16_t *table_ = nullptr;
+  uint16_t mask_ = 0;
+
+public:
+  /// @brief FNV-1a, can be chained over several fragments of one path
+  static uint32_t hash(const char *str, size_t len,
+                       uint32_t h = 2166136261u) {
+    while (len--) {
+      h ^= static_cast<uint8_t>(*str++);
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  /// @brief
+  /// @param bundle
+  auto build(const AssetBundle &bundle) -> void {
+    bundle_ = &bundle;
+
+    if (bundle.index && bundle.indexSize > 0) {
+      slots_.clear();
+      table_ = bundle.index;
+      mask_ = bundle.indexSize - 1;
+      return;
+    }
+
+    // at least twice the number of assets, so probe chains stay short
+    uint16_t size = 4;
+    while (size < bundle.count * 2)
+      size <<= 1;
+
+    slots_.assign(size, 0);
+    mask_ = size - 1;
+
+    for (uint16_t i = 0; i < bundle.count; i++) {
+      auto path = bundle.assets[i].path;
+      auto slot = hash(path, strlen(path)) & mask_;
+      while (slots_[slot] != 0)
+        slot = (slot + 1) & mask_;
+      slots_[slot] = i + 1;
+    }
+
+    table_ = slots_.data();
+  }
+
+  /// @brief Finds the asset at prefix + path, without concatenating.
+  /// @param prefix
+  /// @param path
+  /// @return the asset or nullptr when not found
+  auto find(const String &prefix, const char *path, size_t len) const
+      -> const Asset * {
+    if (!table_)
+      return nullptr;
+
+    auto h = hash(path, len, hash(prefix.c_str(), prefix.length()));
+
+    for (auto slot = h & mask_;; slot = (slot + 1) & mask_) {
+      auto entry = table_[slot];
+      if (entry == 0)
+        return nullptr;
+
+      auto &asset = bundle_->assets[entry - 1];
+      if (strncmp(asset.path, prefix.c_str(), prefix.length()) == 0 &&
+          strncmp(asset.path + prefix.length(), path, len) == 0 &&
+          asset.path[prefix.length() + len] == '\0')
+        return &asset;
+    }
+  }
+
+  /// @brief
+  /// @return the blob the assets point into
+  auto data() const -> const uint8_t * {
+    return bundle_ ? bundle_->data : nullptr;
+  }
+};
@@ -0,0 +1,342 @@
+/*!
+ *  @file       Cookies.cpp
+ *  Project     Arduino Express Library
+ *  @brief      Fast, unopinionated, (very) minimalist web framework for Arduino
+ *  @author     lathoub
+ *  @date       20/01/23
+ *  @license    GNU GENERAL PUBLIC LICENSE
+ *
+ *   Fast, unopinionated, (very) minimalist web framework for Arduino.
+ *   Copyright (C) 2023 lathoub
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define LOG_MODULE LOG_MODULE_REQUEST
+#include "Express.h"
+
+#include <mbedtls/md.h>
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief HMAC-SHA256 of data, base64 encoded without padding (43 chars)
+/// @param out at least 44 bytes, NUL terminated
+static void signature(const char *data, const size_t length,
+                      const String &secret, char *out) {
+  uint8_t mac[32];
+
+  mbedtls_md_context_t ctx;
+  mbedtls_md_init(&ctx);
+  mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+  mbedtls_md_hmac_starts(&ctx,
+                         reinterpret_cast<const uint8_t *>(secret.c_str()),
+                         secret.length());
+  mbedtls_md_hmac_update(&ctx, reinterpret_cast<const uint8_t *>(data),
+                         length);
+  mbedtls_md_hmac_finish(&ctx, mac);
+  mbedtls_md_free(&ctx);
+
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  size_t o = 0;
+  for (size_t i = 0; i < sizeof(mac); i += 3) {
+    uint32_t n = mac[i] << 16;
+    if (i + 1 < sizeof(mac))
+      n |= mac[i + 1] << 8;
+    if (i + 2 < sizeof(mac))
+      n |= mac[i + 2];
+
+    out[o++] = alphabet[(n >> 18) & 63];
+    out[o++] = alphabet[(n >> 12) & 63];
+    if (i + 1 < sizeof(mac))
+      out[o++] = alphabet[(n >> 6) & 63];
+    if (i + 2 < sizeof(mac))
+      out[o++] = alphabet[n & 63];
+  }
+  out[o] = '\0';
+}
+
+/// @brief
+static int hexValue(const char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/// @brief decodeURIComponent
+static String decode(const char *str, const size_t length) {
+  String decoded;
+  decoded.reserve(length);
+
+  for (size_t i = 0; i < length; i++) {
+    int hi, lo;
+    if (str[i] == '%' && i + 2 < length &&
+        (hi = hexValue(str[i + 1])) >= 0 && (lo = hexValue(str[i + 2])) >= 0) {
+      decoded += static_cast<char>((hi << 4) | lo);
+      i += 2;
+    } else
+      decoded += str[i];
+  }
+
+  return decoded;
+}
+
+/// @brief encodeURIComponent
+static void encode(String &out, const String &str) {
+  static const char hex[] = "0123456789ABCDEF";
+
+  for (size_t i = 0; i < str.length(); i++) {
+    auto c = str[i];
+    if (isalnum(static_cast<unsigned char>(c)) || strchr("-_.!~*'()", c))
+      out += c;
+    else {
+      out += '%';
+      out += hex[static_cast<uint8_t>(c) >> 4];
+      out += hex[static_cast<uint8_t>(c) & 15];
+    }
+  }
+}
+
+/// @brief
+/// @param header
+/// @param secret
+auto Cookies::bind(const String *header, const String *secret) -> void {
+  header_ = header;
+  secret_ = secret;
+  parsed_ = false;
+  entries_.clear();
+}
+
+/// @brief name=value; name2=value2
+auto Cookies::parse() -> void {
+  parsed_ = true;
+  if (!header_)
+    return;
+
+  auto str = header_->c_str();
+  size_t i = 0;
+
+  while (str[i]) {
+    while (str[i] == ' ' || str[i] == ';')
+      i++;
+    if (!str[i])
+      break;
+
+    auto nameStart = i;
+    while (str[i] && str[i] != '=' && str[i] != ';')
+      i++;
+    if (str[i] != '=') // not a name=value pair, skip
+      continue;
+
+    auto nameEnd = i++;
+    while (nameEnd > nameStart && str[nameEnd - 1] == ' ')
+      nameEnd--;
+
+    auto valueStart = i;
+    while (str[i] && str[i] != ';')
+      i++;
+    auto valueEnd = i;
+    while (valueEnd > valueStart && str[valueEnd - 1] == ' ')
+      valueEnd--;
+
+    // quoted values
+    if (valueEnd - valueStart >= 2 && str[valueStart] == '"' &&
+        str[valueEnd - 1] == '"') {
+      valueStart++;
+      valueEnd--;
+    }
+
+    // only the first occurrence of a name counts
+    if (find(str + nameStart, nameEnd - nameStart))
+      continue;
+
+    Entry entry{{nameStart, nameEnd - nameStart},
+                {valueStart, valueEnd - valueStart},
+                Plain,
+                {0, 0}};
+
+    // s:value.signature, encoded (s%3A) by res.cookie()
+    auto value = str + valueStart;
+    auto length = valueEnd - valueStart;
+    if ((length > 2 && strncmp(value, "s:", 2) == 0) ||
+        (length > 4 && strncasecmp(value, "s%3A", 4) == 0))
+      entry.state = Unverified;
+
+    entries_.push_back(entry);
+  }
+}
+
+/// @brief
+/// @param name
+/// @return
+auto Cookies::find(const char *name, const size_t length) -> Entry * {
+  if (!header_)
+    return nullptr;
+
+  auto str = header_->c_str();
+
+  for (auto &entry : entries_)
+    if (entry.name.len == length &&
+        strncmp(str + entry.name.pos, name, length) == 0)
+      return &entry;
+
+  return nullptr;
+}
+
+/// @brief checks the signature, once
+/// @param entry
+auto Cookies::verify(Entry &entry) -> void {
+  entry.state = Invalid;
+  if (!secret_)
+    return;
+
+  auto value = decode(header_->c_str() + entry.value.pos, entry.value.len);
+
+  auto dot = value.lastIndexOf('.');
+  if (dot < 2)
+    return;
+
+  char expected[44];
+  signature(value.c_str() + 2, dot - 2, *secret_, expected);
+
+  // constant time, the signature must not leak through timing
+  auto given = value.c_str() + dot + 1;
+  auto length = value.length() - dot - 1;
+  uint8_t diff = (length == strlen(expected)) ? 0 : 1;
+  for (size_t i = 0; i < length && i < sizeof(expected); i++)
+    diff |= given[i] ^ expected[i];
+  if (diff != 0)
+    return;
+
+  entry.state = Verified;
+  entry.payload = {2, static_cast<size_t>(dot) - 2};
+}
+
+/// @brief
+/// @param name
+/// @return
+auto Cookies::has(const String &name) -> bool {
+  if (!parsed_)
+    parse();
+
+  return find(name.c_str(), name.length()) != nullptr;
+}
+
+/// @brief
+/// @param name
+/// @return
+auto Cookies::get(const String &name) -> String {
+  if (!parsed_)
+    parse();
+
+  auto entry = find(name.c_str(), name.length());
+  if (!entry || entry->state != Plain)
+    return F("");
+
+  return decode(header_->c_str() + entry->value.pos, entry->value.len);
+}
+
+/// @brief
+/// @param name
+/// @return
+auto Cookies::getSigned(const String &name) -> String {
+  if (!parsed_)
+    parse();
+
+  auto entry = find(name.c_str(), name.length());
+  if (!entry || entry->state == Plain)
+    return F("");
+
+  if (entry->state == Unverified)
+    verify(*entry);
+
+  if (entry->state != Verified)
+    return F("");
+
+  // the payload is relative to the decoded value
+  auto value = decode(header_->c_str() + entry->value.pos, entry->value.len);
+  return value.substring(entry->payload.pos,
+                         entry->payload.pos + entry->payload.len);
+}
+
+/// @brief
+/// @return
+auto Cookies::size() -> size_t {
+  if (!parsed_)
+    parse();
+
+  return entries_.size();
+}
+
+/// @brief
+/// @param value
+/// @param secret
+/// @return
+auto Cookies::sign(const String &value, const String &secret) -> String {
+  char mac[44];
+  signature(value.c_str(), value.length(), secret, mac);
+
+  String signed_;
+  signed_.reserve(value.length() + 46);
+  signed_ += F("s:");
+  signed_ += value;
+  signed_ += '.';
+  signed_ += mac;
+  return signed_;
+}
+
+/// @brief
+/// @param name
+/// @param value
+/// @param options
+/// @return
+auto Cookies::serialize(const String &name, const String &value,
+                        const CookieOptions &options) -> String {
+  String cookie;
+  cookie.reserve(name.length() + value.length() + 32);
+
+  cookie += name;
+  cookie += '=';
+  encode(cookie, value);
+
+  if (options.maxAge >= 0) {
+    cookie += F("; Max-Age=");
+    cookie += options.maxAge / 1000;
+  }
+  if (options.domain.length() > 0) {
+    cookie += F("; Domain=");
+    cookie += options.domain;
+  }
+  if (options.path.length() > 0) {
+    cookie += F("; Path=");
+    cookie += options.path;
+  }
+  if (options.httpOnly)
+    cookie += F("; HttpOnly");
+  if (options.secure)
+    cookie += F("; Secure");
+  if (options.sameSite.length() > 0) {
+    cookie += F("; SameSite=");
+    cookie += options.sameSite;
+  }
+
+  return cookie;
+}
+
+END_EXPRESS_NAMESPACE
@@ -0,0 +1,80 @@
+/// @brief Attributes of a cookie set by res.cookie().
+class CookieOptions {
+public:
+  /// Domain name for the cookie. Defaults to the domain name of the app.
+  String domain{};
+  /// Path for the cookie.
+  String path = F("/");
+  /// Expiry time relative to the current time in milliseconds, < 0: a session
+  /// cookie.
+  int32_t maxAge = -1;
+  /// Flags the cookie to be accessible only by the web server.
+  bool httpOnly = false;
+  /// Marks the cookie to be used with HTTPS only.
+  bool secure = false;
+  /// Value of the SameSite attribute (Strict, Lax or None), empty: not set.
+  String sameSite{};
+  /// Signs the value with the app's "cookie secret" setting, read back with
+  /// req.cookies.getSigned().
+  bool sign = false;
+};
+
+/// @brief The cookies of a request. The Cookie header is only parsed on first
+/// access, into views over the header value; nothing is copied until a value
+/// is asked for. Signed values are verified at most once per request.
+class Cookies {
+private:
+  enum State : uint8_t { Plain, Unverified, Verified, Invalid };
+
+  struct Entry {
+    PosLen name;
+    PosLen value;
+    State state;
+    PosLen payload; // the unsigned part of a verified value
+  };
+
+  const String *header_ = nullptr;
+  const String *secret_ = nullptr;
+  bool parsed_ = false;
+  std::vector<Entry> entries_{};
+
+  /// @brief
+  auto parse() -> void;
+
+  /// @brief
+  /// @return the entry or nullptr
+  auto find(const char *name, const size_t length) -> Entry *;
+
+  /// @brief
+  auto verify(Entry &) -> void;
+
+public:
+  /// @brief Points to the Cookie header and the secret signed cookies are
+  /// verified with, both may be nullptr. Does not parse.
+  auto bind(const String *header, const String *secret) -> void;
+
+  /// @brief
+  /// @return true if the request has the cookie
+  auto has(const String &name) -> bool;
+
+  /// @brief
+  /// @return the (decoded) value of an unsigned cookie, empty when absent
+  auto get(const String &name) -> String;
+
+  /// @brief
+  /// @return the value of a signed cookie whose signature is valid, empty
+  /// when absent, not signed or tampered with
+  auto getSigned(const String &name) -> String;
+
+  /// @brief
+  /// @return the number of cookies in the request
+  auto size() -> size_t;
+
+  /// @brief Signs value with secret (s:value.signature, compatible with
+  /// cookie-signature)
+  static auto sign(const String &value, const String &secret) -> String;
+
+  /// @brief Serializes a Set-Cookie header value, the value is URI encoded.
+  static auto serialize(const String &name, const String &value,
+                        const CookieOptions &) -> String;
+};
@@ -23,10 +23,16 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define LOG_MODULE LOG_MODULE_EXPRESS
 #include "Express.h"
 
 BEGIN_EXPRESS_NAMESPACE
 
+#ifdef EXPRESS_TRACE
+TraceRecord Trace::record{};
+TraceCallback Trace::callback = nullptr;
+#endif
+
 /// @brief
 /// @return
 _Express::_Express() {
@@ -324,6 +330,8 @@ void _Express::listen(uint16_t port, const Callback startedCallback) {
 auto _Express::run() -> void {
   if (auto client = server->available())
     run(client);
+  else
+    LOG_FLUSH(); // idle, print the deferred log
 }
 
 /// @brief
@@ -331,16 +339,11 @@ auto _Express::run() -> void {
 void _Express::run(ClientType &client) {
   while (client.connected()) {
     if (client.available()) {
-      // Construct request object and read/parse incoming bytes
-      _Request req(*this, client);
-
-      if (req.method_ != Method::ERROR) {
-        _Response res(*this, client);
-
-        router_->dispatch(req, res);
-
-        res.send();
-      }
+      if (recorder_) {
+        TrafficTap tap(client, *recorder_);
+        handle(tap);
+      } else
+        handle(client);
 
       // Arduino Ethernet stop() is potentially slow, this makes it faster
 #if PLATFORM == ESP32_W5500
@@ -351,4 +354,37 @@ void _Express::run(ClientType &client) {
   }
 };
 
+/// @brief
+/// @param client
+auto _Express::handle(ClientType &client) -> void {
+  auto start = micros();
+  EXPRESS_TRACE_START();
+  EXPRESS_TRACE_BEGIN(Parse);
+
+  // Construct request object and read/parse incoming bytes
+  _Request req(*this, client);
+  EXPRESS_TRACE_END(Parse);
+
+  if (req.method_ == Method::ERROR)
+    return;
+
+  auto parsed = micros();
+
+  _Response res(*this, client, req);
+
+  router_->dispatch(req, res);
+  auto dispatched = micros();
+
+  res.send();
+  auto sent = micros();
+
+  auto &metrics = req.route ? req.route->metrics : unmatched_;
+  metrics.record(res.status_, req.headerLength_ + req.body.length(),
+                 res.out_.written, parsed - start, dispatched - parsed,
+                 sent - dispatched);
+
+  EXPRESS_TRACE_ROUTE(req.route);
+  EXPRESS_TRACE_FINISH();
+}
+
 END_EXPRESS_NAMESPACE
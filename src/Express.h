@@ -36,20 +36,51 @@ class _Route;
 class _Error;
 class _Router;
 class _Express;
+class Session;
+
+/// @brief Where a request is in one chain of middlewares (or error
+/// handlers). The router running the chain keeps it on its stack, so every
+/// request, and every chain within one, has its own.
+struct _Cursor {
+  _Request &req;
+  size_t position; // index of the middleware to run
+};
+
+/// @brief The next() handed to a middleware: moves the cursor of its chain
+/// past that middleware and records the error, when given one, in the
+/// request. Calling it more than once has no further effect. Call it before
+/// the middleware returns.
+class _Next {
+private:
+  _Cursor *cursor_ = nullptr;
+  size_t index_ = 0;
+
+public:
+  /// @brief a next() that does nothing, to call a middleware directly
+  _Next(std::nullptr_t = nullptr) {}
+
+  _Next(_Cursor &cursor, const size_t index)
+      : cursor_(&cursor), index_(index) {}
+
+  void operator()(const _Error *error = nullptr) const;
+};
 
 // Callback definitions
-using NextCallback = void (*)(const _Error *error);
+using NextCallback = _Next;
 using ErrorCallback = void (*)(_Error &, _Request &, _Response &,
                                const NextCallback next);
 using MiddlewareCallback = void (*)(_Request &, _Response &,
                                     const NextCallback next);
-using RenderEngineCallback = void (*)(ClientType &, locals_t &locals, Options *,
-                                      const char *f);
+using RenderEngineCallback = void (*)(Print &, const Locals &locals,
+                                      Options *, const char *f,
+                                      const size_t length);
 using Callback = void (*)();
 using DataCallback = void (*)(const Buffer &);
 using EndDataCallback = void (*)();
 using MountCallback = void (*)(_Express *);
 using Write_Callback = void (*)(const char *, const uint &);
+using FormatCallback = void (*)(_Request &, _Response &);
+using FinishCallback = void (*)(_Request &, _Response &);
 
 /// @brief
 class _Error {
@@ -84,6 +115,10 @@ public:
   /// @brief
   std::map<String, RenderEngineCallback> engines;
 
+  /// @brief Rendered views, disabled until given a capacity in bytes:
+  /// app.viewCache.capacity(8192);
+  RenderCache viewCache;
+
   /// @brief The app.locals object has properties that are local variables
   /// within the application, and will be available in templates rendered
   // with res.render.
@@ -135,9 +170,58 @@ private:
   static auto parseUrlencoded(_Request &, _Response &,
                               const NextCallback callback = nullptr) -> void;
 
-  /// @brief This is a built-in middleware function in _Express. It serves
-  /// static files and is based on serve-static.
-  // static void Static() {}
+  /// @brief the assets and options of one Static() middleware
+  struct StaticAssets {
+    AssetIndex index{};
+    Options options{};
+  };
+
+  /// @brief one per Static() call, see EXPRESS_STATIC_INSTANCES
+  static StaticAssets staticAssets_[EXPRESS_STATIC_INSTANCES];
+
+  /// @brief
+  static size_t staticCount_;
+
+  /// @brief
+  /// @param assets
+  /// @param req
+  /// @param res
+  /// @return
+  static auto serveStatic(const StaticAssets &, _Request &, _Response &,
+                          const NextCallback) -> void;
+
+  /// @brief the middleware of Static() instance I
+  template <size_t I>
+  static auto serveStatic(_Request &req, _Response &res,
+                          const NextCallback next) -> void {
+    serveStatic(staticAssets_[I], req, res, next);
+  }
+
+  /// @brief serveStatic<i>, for a runtime i
+  template <size_t I>
+  static auto serveStaticAt(const size_t i) -> MiddlewareCallback {
+    return (i == I) ? serveStatic<I> : serveStaticAt<I + 1>(i);
+  }
+
+  /// @brief requests no route matched
+  Metrics unmatched_{};
+
+  /// @brief see record()
+  TrafficRecorder *recorder_ = nullptr;
+
+  /// @brief parses, dispatches and answers one request
+  /// @param client
+  auto handle(ClientType &client) -> void;
+
+  /// @brief
+  static auto writeMetrics(_Request &, _Response &,
+                           const NextCallback callback = nullptr) -> void;
+
+  /// @brief all routes of router and its child routers, with their full
+  /// path: the mount paths of the routers above (parents) and their own
+  static auto collectRoutes(const _Router &, const String &parents,
+                            std::vector<const _Route *> &,
+                            std::vector<String> &paths) -> void;
 
 public:
   /// @brief
@@ -161,6 +245,24 @@ public:
   /// inflation of gzip and deflate encodings.
   static auto urlencoded() -> MiddlewareCallback;
 
+  /// @brief This is a built-in middleware function in _Express. It serves
+  /// static files and is based on serve-static. Files are looked up (by
+  /// options.root + req.uri, less the path it is mounted on) in the bundle;
+  /// when not found, next() is called. Each call serves its own bundle, up to
+  /// EXPRESS_STATIC_INSTANCES of them:
+  ///
+  ///     app.use(F("/docs"), express::Static(docs::bundle));
+  /// @param bundle
+  /// @param options
+  /// @return
+  static auto Static(const AssetBundle &, const Options & = Options())
+      -> MiddlewareCallback;
+
+  /// @brief Serves the request metrics of all routes in the Prometheus text
+  /// format: app.get(F("/metrics"), express::metrics());
+  /// @return
+  static auto metrics() -> MiddlewareCallback;
+
   ///
   static auto Router() -> _Router &;
 
@@ -273,18 +375,14 @@ public:
   /// @param callback
   /// @return
   template <typename... Args>
-  auto head(const String &path, Args... args) -> _Route & {
-    return router_->head(path, args...);
-  };
+  auto head(const String &path, Args... args) -> _Route &;
 
   /// @brief
   /// @param path
   /// @param callback
   /// @return
   template <typename... Args>
-  auto get(const String &path, Args... args) -> _Route & {
-    return router_->get(path, args...);
-  };
+  auto get(const String &path, Args... args) -> _Route &;
 
   /// @brief
   /// @param path
@@ -292,36 +390,28 @@ public:
   /// @param callback
   /// @return
   template <typename... Args>
-  auto post(const String &path, Args... args) -> _Route & {
-    return router_->post(path, args...);
-  };
+  auto post(const String &path, Args... args) -> _Route &;
 
   /// @brief
   /// @param path
   /// @param callback
   /// @return
   template <typename... Args>
-  auto put(const String &path, Args... args) -> _Route & {
-    return router_->put(path, args...);
-  };
+  auto put(const String &path, Args... args) -> _Route &;
 
   /// @brief Routes HTTP DELETE requests to the specified path with the
   /// specified callback functions. For more information, see the routing guide.
   /// @param path
   /// @param callback
   template <typename... Args>
-  auto del(const String &path, Args... args) -> _Route & {
-    return router_->del(path, args...);
-  }
+  auto del(const String &path, Args... args) -> _Route &;
 
   /// @brief This method is like the standard app.METHOD() methods, except it
   /// matches all HTTP verbs.
   /// @param path
   /// @param callback
   template <typename... Args>
-  auto all(const String &path, Args... args) -> _Route & {
-    return router_->all(path, args...);
-  }
+  auto all(const String &path, Args... args) -> _Route &;
 
   /// @brief Returns the canonical path of the app, a string.
   /// @return
@@ -341,12 +431,18 @@ public:
   /// @brief
   /// @param client
   void run(ClientType &client);
+
+  /// @brief Records the bytes of every client served by run() from now on,
+  /// nullptr stops recording.
+  /// @param recorder
+  auto record(TrafficRecorder *recorder) -> void { recorder_ = recorder; }
 };
 
 /// @brief
 class _Request {
   friend class _Router;
   friend class _Express;
+  friend class _Next;
 
 public:
   /// @brief
@@ -359,6 +455,10 @@ public:
 
   String uri{};
 
+  /// @brief The path the running middleware was mounted on with
+  /// app.use(path, middleware), "" otherwise.
+  String baseUrl{};
+
   /// @brief
   String body{};
 
@@ -374,6 +474,9 @@ public:
   /// @brief Contains the remote IP address of the request.
   IPAddress ip{};
 
+  /// @brief micros() when the request arrived, before it was parsed
+  uint32_t received = micros();
+
   /// @brief Contains the remote IP address of the request.
   std::vector<IPAddress> ips{};
 
@@ -407,6 +510,14 @@ public:
   /// @brief
   std::map<String, String> query;
 
+  /// @brief The cookies sent by the client, parsed on first use. Signed
+  /// cookies are read with cookies.getSigned() and verified with the
+  /// "cookie secret" setting.
+  Cookies cookies{};
+
+  /// @brief The session of the request, set by the session middleware.
+  Session *session = nullptr;
+
   /// @brief This property is an object containing properties mapped to the
   /// named route “parameters”. For example, if you have the route /user/:name,
   /// then the “name” property is available as
@@ -419,20 +530,27 @@ public: /* Methods*/
 
   /// @brief Checks if the specified content types are acceptable, based on the
   /// request’s Accept HTTP header field. The method returns the best match, or
-  /// if none of the specified content types is acceptable, returns false (in
-  /// which case, the application should respond with 406 "Not Acceptable").
-  auto accepts(const String &) -> bool;
+  /// if none of the specified content types is acceptable, returns an empty
+  /// string (in which case, the application should respond with 406 "Not
+  /// Acceptable").
+  /// @param types comma separated media types or extensions ("json, html")
+  auto accepts(const String &types) -> String;
+
+  /// @brief The quality (0..1000) the Accept header gives to a media type or
+  /// extension, 1000 when there is no Accept header. Does not allocate.
+  auto acceptQuality(const char *type) const -> int;
 
   /// @brief Returns the matching content type if the incoming request’s
   /// “Content-Type” HTTP header field matches the MIME type specified by the
-  /// type parameter. If the request has no body, returns null. Returns false
-  /// otherwise.
-  auto is(const String &) -> String;
+  /// type parameter. Parameters such as charset are ignored. If the request has
+  /// no body, or nothing matches, returns an empty string.
+  /// @param types comma separated media types, wildcards or extensions
+  auto is(const String &types) -> String;
 
   /// @brief Range header parser.
   /// The size parameter is the maximum size of the resource.
   /// The options parameter is an object that can have the following properties.
-  auto range(const size_t & = SIZE_MAX) -> const Range &;
+  auto range(const size_t & = SIZE_MAX) -> Range;
 
   /// @brief Returns the specified HTTP request header field (case-insensitive
   /// match).
@@ -440,10 +558,19 @@ public: /* Methods*/
   /// @return
   auto get(const String &) -> String;
 
-  /// @brief
+  /// @brief Like get(), without copying the value.
+  /// @return the header value (case-insensitive match), nullptr when absent
+  auto header(const String &field) const -> const String *;
+
+  /// @brief Parses a Range header, clamped to maxSize bytes in total.
   /// @param data
-  static auto rangeParse(const String &, const size_t & = INT_MAX)
-      -> const Range &;
+  /// @return no ranges when there are none, or they overlap
+  static auto rangeParse(const String &, const size_t & = INT_MAX) -> Range;
+
+  /// @brief Decodes %XX escapes and '+' (space).
+  /// @param text
+  /// @return
+  static auto urlDecode(const String &) -> String;
 
 private:
   /// @brief
@@ -451,27 +578,41 @@ private:
   /// @return
   bool parse(ClientType &);
 
-  /// @brief
-  Range range_;
-
   /// @brief
   Method method_{};
 
+  /// @brief bytes of the request line and headers
+  size_t headerLength_ = 0;
+
+  /// @brief the message of the error passed to next(), copied (cut to fit):
+  /// the caller's error may be gone by the time the error handlers run
+  static const size_t maxErrorMessage = 64;
+  char errorMessage_[maxErrorMessage]{};
+  bool failed_ = false;
+
+  /// @brief the error the error handlers are given, while they run
+  const _Error *error_ = nullptr;
+
   /// @brief
   /// @param data
   auto parseArguments(const String &) -> void;
+};
 
-  /// @brief
-  /// @param text
-  /// @return
-  static auto urlDecode(const String &) -> String;
+/// @brief One entry of a res.format() table: a media type (or extension) and
+/// the callback that responds with it. A nullptr type marks the default
+/// callback.
+struct Format {
+  const char *type;
+  FormatCallback callback;
 };
 
 /// @brief
 class _Response {
+  friend class _Express;
+
 private:
-  static void renderFile(ClientType &, Options *, const char *f,
-                         const Write_Callback);
+  static void renderFile(Print &, Options *, const uint8_t *data,
+                         const size_t length, const Write_Callback);
 
 public:
   /// @brief
@@ -490,33 +631,97 @@ public:
   /// @return
   _Express &app;
 
+  /// @brief This property holds a reference to the request object that
+  /// relates to this response object.
+  _Request &req;
+
+  /// @brief Local variables scoped to the request, available to the view
+  /// rendered by res.render (below its own locals, above app.locals).
+  locals_t locals;
+
 private:
   String body_{};
 
+  /// @brief Set-Cookie header values, there can be more than one
+  std::vector<String> cookies_{};
+
   /// @brief derefered rendering
-  ContentCallback contentsCallback{};
+  File file_{};
 
-  locals_t renderLocals{};
+  /// @brief body bytes that are written as-is (not copied)
+  const uint8_t *bodyData_ = nullptr;
+  size_t bodyLength_ = 0;
+
+  /// @brief bytes of the status line and headers sent by send()
+  size_t headerLength_ = 0;
 
-  String filename;
+  locals_t renderLocals{};
 
   Options *options = nullptr;
 
+  /// @brief status line, headers and body are written into this buffer
+  OutputBuffer out_;
+
+  /// @brief identifies file_ rendered with its locals in app.viewCache
+  uint64_t viewFingerprint_ = 0;
+
+  /// @brief
+  static const size_t maxFinishCallbacks = 4;
+  FinishCallback finish_[maxFinishCallbacks]{};
+  uint8_t finishCount_ = 0;
+
+  /// @brief
+  auto viewEngine() -> RenderEngineCallback;
+
+  /// @brief
+  void finish();
+
 public:
   /// @brief
   /// @param client
   void evaluateHeaders(ClientType &);
 
   /// @brief
-  /// @param client
-  void sendBody(ClientType &, locals_t &);
+  /// @param out
+  void sendBody(Print &, const Locals &);
 
   /// @brief
   void send();
 
+  /// @brief Sends the buffered output to the client now, rather than when
+  /// the buffer is full or the response ends.
+  void flush();
+
+  /// @brief Sends a complete response recorded earlier (eg by a cache):
+  /// status line, headers and body. Set headersSent for send() to add
+  /// nothing.
+  /// @param status the recorded status, for the finish callbacks
+  /// @param data
+  /// @param length
+  /// @param headerLength bytes of the status line and headers in data
+  void replay(const HttpStatus status, const uint8_t *data,
+              const size_t length, const size_t headerLength);
+
+  /// @brief Copies everything send() writes (status line, headers and body)
+  /// to capture as well. When muted, the client gets nothing.
+  /// @param capture nullptr stops copying
+  /// @param muted
+  void capture(Print *capture, const bool muted = false);
+
+  /// @brief
+  /// @return bytes of the body sent so far. When a middleware answered the
+  /// client itself, everything it wrote.
+  auto bytesSent() const -> size_t { return out_.written - headerLength_; }
+
+  /// @brief Calls callback once the response has been sent, also when a
+  /// middleware already answered the client itself (headersSent). At most
+  /// maxFinishCallbacks callbacks, returns false when full.
+  /// @param callback
+  auto onFinish(const FinishCallback callback) -> bool;
+
 public: /* Methods*/
   /// @brief Constructor
-  _Response(_Express &, ClientType &);
+  _Response(_Express &, ClientType &, _Request &);
 
   /// @brief Appends the specified value to the HTTP response header field. If
   /// the header is not already set, it creates the header with the specified
@@ -534,16 +739,43 @@ public: /* Methods*/
   /// When no match is found, the server responds with 406 “Not Acceptable”, or
   /// invokes the default callback.
   ///
-  /// The Content-Type response header is set when a callback is selected.
-  /// However, you may alter this within the callback using methods such as
-  /// res.set() or res.type().
-  auto format() -> void;
+  /// The Content-Type response header is set when a callback is selected,
+  /// and Accept is added to the Vary header. However, you may alter this
+  /// within the callback using methods such as res.set().
+  /// @param formats table of types and callbacks, typically static const
+  /// @param count
+  auto format(const Format *formats, const size_t count) -> void;
+
+  /// @brief
+  template <size_t N> auto format(const Format (&formats)[N]) -> void {
+    format(formats, N);
+  }
+
+  /// @brief Adds the field to the Vary response header, if it is not already
+  /// there.
+  /// @param field
+  auto vary(const String &field) -> _Response &;
 
   auto download(File &) -> void;
 
-  auto cookie() -> void;
+  /// @brief Sets cookie name to value. With options.sign, the value is signed
+  /// with the "cookie secret" setting.
+  /// @param name
+  /// @param value
+  /// @param options
+  /// @return
+  auto cookie(const String &name, const String &value,
+              const CookieOptions &options = CookieOptions()) -> _Response &;
 
-  auto clearCookie(const String &) -> void;
+  /// @brief Clears the cookie specified by name. Web browsers only clear the
+  /// cookie if the given options are identical to those given to res.cookie(),
+  /// excluding maxAge.
+  /// @param name
+  /// @param options
+  /// @return
+  auto clearCookie(const String &name,
+                   const CookieOptions &options = CookieOptions())
+      -> _Response &;
 
   /// @brief Ends the response process. This method actually comes from Node
   /// core, specifically the response.end() method of http.ServerResponse.
@@ -553,6 +785,13 @@ public: /* Methods*/
   auto end(Buffer *data = nullptr, const String &encoding = F(""))
       -> _Response &;
 
+  /// @brief Ends the response process with a binary body. The bytes are not
+  /// copied, they must remain valid until the response is sent.
+  /// @param data
+  /// @param length
+  /// @return
+  auto end(const uint8_t *data, const size_t length) -> _Response &;
+
   /// @brief Ends the response process
   static void end();
 
@@ -583,8 +822,19 @@ public: /* Methods*/
   ///      possible error and rendered string, but does not perform an automated
   ///      response. When an error occurs, the method invokes next(err)
   ///      internally.
+  /// The view sees these locals, then res.locals, then app.locals. The view
+  /// is rendered after the route handler returned, so locals is copied into
+  /// the response; pass std::move(locals) to take it over instead.
+  /// @param view
+  auto render(File &, const locals_t &) -> void;
+
+  /// @brief Renders a view, taking locals over rather than copying them.
   /// @param view
-  auto render(File &, locals_t &) -> void;
+  auto render(File &, locals_t &&) -> void;
+
+  /// @brief Renders a view with res.locals and app.locals.
+  /// @param view
+  auto render(File &) -> void;
 
   /// @brief .
   auto sendFile(const File &, Options *options = nullptr) -> void;
@@ -631,6 +881,9 @@ public:
   // cache path splitting (avoid doing this for every request * number of paths)
   std::vector<PosLen> indices;
 
+  /// @brief
+  Metrics metrics{};
+
 public:
   /// @brief
   _Route();
@@ -658,6 +911,8 @@ public:
 
 /// @brief
 class _Router {
+  friend class _Express;
+
 private:
   /// @brief The app.mountpath property contains the path patterns
   /// on which a sub-app was mounted.
@@ -666,6 +921,10 @@ private:
   /// @brief Application wide middlewares
   std::vector<MiddlewareCallback> middlewares{};
 
+  /// @brief The path each of the middlewares is mounted on, "" (or left out)
+  /// when it runs for every request
+  std::vector<String> middlewarePaths_{};
+
   /// @brief Application wide middlewares
   std::vector<ErrorCallback> errorHandlers{};
 
@@ -678,9 +937,6 @@ private:
   /// @brief routes
   std::vector<_Route *> routes{};
 
-  /// @brief
-  static bool gotoNext;
-
 public:
   /// @brief Enable case sensitivity
   /// Disabled by default, treating “/Foo” and “/foo” as the same.
@@ -717,6 +973,27 @@ private:
   /// @param res
   auto evaluate(_Request &, _Response &) -> bool;
 
+  /// @brief Runs middlewares in order, for as long as they call next().
+  /// Those mounted on a path (paths, parallel to the middlewares) are skipped
+  /// for requests outside of it.
+  /// @return true when all of them did, without an error. After an error,
+  /// the error handlers have run.
+  auto run(const std::vector<MiddlewareCallback> &, _Request &, _Response &,
+           const std::vector<String> *paths = nullptr) -> bool;
+
+  /// @brief
+  /// @return true when path is "" or a leading path segment(s) of uri
+  static auto mounted(const String &path, const String &uri) -> bool;
+
+  /// @brief Runs a middleware. Where exceptions are enabled, a thrown _Error
+  /// (or _Error *) is passed to next().
+  static auto call(const MiddlewareCallback, _Request &, _Response &,
+                   const _Next &) -> void;
+
+  /// @brief Responds with 500 and runs the error handlers on the error
+  /// recorded by next(), for as long as they call next().
+  auto fail(_Request &, _Response &) -> void;
+
   /// https://expressjs.com/en/guide/writing-middleware.html
   /// https://expressjs.com/en/guide/using-middleware.html
 
@@ -876,6 +1153,38 @@ public:
 
 };
 
+// _Express routing methods, defined where _Router is complete
+
+template <typename... Args>
+auto _Express::head(const String &path, Args... args) -> _Route & {
+  return router_->head(path, args...);
+}
+
+template <typename... Args>
+auto _Express::get(const String &path, Args... args) -> _Route & {
+  return router_->get(path, args...);
+}
+
+template <typename... Args>
+auto _Express::post(const String &path, Args... args) -> _Route & {
+  return router_->post(path, args...);
+}
+
+template <typename... Args>
+auto _Express::put(const String &path, Args... args) -> _Route & {
+  return router_->put(path, args...);
+}
+
+template <typename... Args>
+auto _Express::del(const String &path, Args... args) -> _Route & {
+  return router_->del(path, args...);
+}
+
+template <typename... Args>
+auto _Express::all(const String &path, Args... args) -> _Route & {
+  return router_->all(path, args...);
+}
+
 END_EXPRESS_NAMESPACE
 
 #define EXPRESS_CREATE_NAMED_INSTANCE(Name)                                    \
@@ -0,0 +1,184 @@
+/// @brief Media type matching for content negotiation. Everything works on
+/// the header text in place, nothing is allocated.
+class MediaType {
+private:
+  /// @brief
+  struct Extension {
+    const char *ext;
+    const char *type;
+  };
+
+  /// @brief
+  static bool equals(const char *a, const char *aEnd, const char *b,
+                     const char *bEnd) {
+    return (aEnd - a == bEnd - b) && strncasecmp(a, b, aEnd - a) == 0;
+  }
+
+  /// @brief
+  static bool isSpace(const char c) { return c == ' ' || c == '\t'; }
+
+  /// @brief q=0.8 as thousandths
+  static int parseQuality(const char *p) {
+    int q = (*p == '1') ? 1000 : 0;
+    if (*p == '0' || *p == '1')
+      p++;
+    if (*p == '.') {
+      p++;
+      for (int scale = 100; scale > 0 && *p >= '0' && *p <= '9'; scale /= 10)
+        q += (*p++ - '0') * scale;
+    }
+    return (q > 1000) ? 1000 : q;
+  }
+
+public:
+  /// @brief
+  /// @return the media type for a short name or extension (html, json, ..),
+  /// nullptr when unknown
+  static const char *lookup(const char *ext, const size_t length) {
+    static const Extension extensions[] = {
+        {"html", "text/html"},
+        {"htm", "text/html"},
+        {"json", "application/json"},
+        {"text", "text/plain"},
+        {"txt", "text/plain"},
+        {"xml", "application/xml"},
+        {"css", "text/css"},
+        {"js", "application/javascript"},
+        {"csv", "text/csv"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"svg", "image/svg+xml"},
+        {"ico", "image/x-icon"},
+        {"bin", "application/octet-stream"},
+        {"urlencoded", "application/x-www-form-urlencoded"},
+        {"multipart", "multipart/*"},
+    };
+
+    for (auto &extension : extensions)
+      if (strlen(extension.ext) == length &&
+          strncasecmp(extension.ext, ext, length) == 0)
+        return extension.type;
+    return nullptr;
+  }
+
+  /// @brief Resolves a type as given by the application: a full media type,
+  /// or a short name / extension.
+  /// @return false when type is neither
+  static bool resolve(const char *&type, const char *&end) {
+    if (memchr(type, '/', end - type) != nullptr)
+      return true;
+
+    auto resolved = lookup(type, end - type);
+    if (!resolved)
+      return false;
+
+    type = resolved;
+    end = resolved + strlen(resolved);
+    return true;
+  }
+
+  /// @brief Matches two media types, either may use * wildcards (text/*,
+  /// */*). Parameters are not part of the types. Also matches single tokens,
+  /// as in Accept-Encoding (gzip, *).
+  /// @return the number of non-wildcard parts that matched (0..2), or -1
+  static int match(const char *a, const char *aEnd, const char *b,
+                   const char *bEnd) {
+    auto aSlash = static_cast<const char *>(memchr(a, '/', aEnd - a));
+    auto bSlash = static_cast<const char *>(memchr(b, '/', bEnd - b));
+    if (!aSlash && !bSlash) {
+      if ((aEnd - a == 1 && *a == '*') || (bEnd - b == 1 && *b == '*'))
+        return 0;
+      return equals(a, aEnd, b, bEnd) ? 1 : -1;
+    }
+    if (!aSlash || !bSlash)
+      return -1;
+
+    int specificity = 0;
+
+    auto aAny = (aSlash - a == 1 && *a == '*');
+    auto bAny = (bSlash - b == 1 && *b == '*');
+    if (!aAny && !bAny) {
+      if (!equals(a, aSlash, b, bSlash))
+        return -1;
+      specificity++;
+    }
+
+    aAny = (aEnd - aSlash == 2 && aSlash[1] == '*');
+    bAny = (bEnd - bSlash == 2 && bSlash[1] == '*');
+    if (!aAny && !bAny) {
+      if (!equals(aSlash + 1, aEnd, bSlash + 1, bEnd))
+        return -1;
+      specificity++;
+    }
+
+    return specificity;
+  }
+
+  /// @brief The quality an Accept header gives to a media type: the q value
+  /// of the most specific media range that matches it. The same for a coding
+  /// in an Accept-Encoding header.
+  /// @param accept the Accept (or Accept-Encoding) header value
+  /// @return 0..1000, 0 when not acceptable
+  static int quality(const char *accept, const char *type,
+                     const char *typeEnd) {
+    int best = 0;
+    int bestSpecificity = -1;
+
+    auto p = accept;
+    while (*p) {
+      while (isSpace(*p) || *p == ',')
+        p++;
+      if (*p == '\0')
+        break;
+
+      auto range = p;
+      while (*p && *p != ',' && *p != ';' && !isSpace(*p))
+        p++;
+      auto rangeEnd = p;
+
+      // parameters, only q matters
+      int q = 1000;
+      while (*p && *p != ',') {
+        if (*p == ';') {
+          p++;
+          while (isSpace(*p))
+            p++;
+          if ((*p == 'q' || *p == 'Q') && p[1] == '=')
+            q = parseQuality(p + 2);
+        } else
+          p++;
+      }
+
+      auto specificity = match(range, rangeEnd, type, typeEnd);
+      if (specificity > bestSpecificity) {
+        bestSpecificity = specificity;
+        best = q;
+      }
+    }
+
+    return best;
+  }
+
+  /// @brief Calls callback for every item of a comma separated list, with
+  /// surrounding spaces trimmed. Stops when callback returns false.
+  template <typename Callback>
+  static void forEach(const char *list, Callback callback) {
+    auto p = list;
+    while (*p) {
+      while (isSpace(*p) || *p == ',')
+        p++;
+      if (*p == '\0')
+        break;
+
+      auto item = p;
+      while (*p && *p != ',')
+        p++;
+      auto itemEnd = p;
+      while (itemEnd > item && isSpace(itemEnd[-1]))
+        itemEnd--;
+
+      if (!callback(item, itemEnd))
+        return;
+    }
+  }
+};
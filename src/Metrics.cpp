@@ -0,0 +1,233 @@
+/*!
+ *  @file       Metrics.cpp
+ *  Project     Arduino Express Library
+ *  @brief      Fast, unopinionated, (very) minimalist web framework for Arduino
+ *  @author     lathoub
+ *  @date       20/01/23
+ *  @license    GNU GENERAL PUBLIC LICENSE
+ *
+ *   Fast, unopinionated, (very) minimalist web framework for Arduino.
+ *   Copyright (C) 2023 lathoub
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define LOG_MODULE LOG_MODULE_EXPRESS
+#include "Express.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief a route, or the requests no route matched (route == nullptr)
+struct MetricsSource {
+  const _Route *route;
+  const Metrics *metrics;
+  const String *path; // the full path of route
+};
+
+/// @brief
+static const char *methodName(const Method method) {
+  static const char *names[] = {"GET",     "HEAD",    "POST",  "PUT",
+                                "DELETE",  "CONNECT", "OPTIONS", "TRACE",
+                                "PATCH",   "ALL"};
+  return (method <= Method::ALL) ? names[method] : "";
+}
+
+/// @brief
+/// @param router
+/// @param parents
+/// @param routes
+/// @param paths
+auto _Express::collectRoutes(const _Router &router, const String &parents,
+                             std::vector<const _Route *> &routes,
+                             std::vector<String> &paths) -> void {
+  auto mountpath = router.mountpath;
+  if (mountpath == F("/"))
+    mountpath = F("");
+
+  for (auto route : router.routes) {
+    routes.push_back(route);
+    // routes added after the router was mounted have its mount path already
+    if (mountpath.length() > 0 && !route->path.startsWith(mountpath))
+      paths.push_back(parents + mountpath + route->path);
+    else
+      paths.push_back(parents + route->path);
+  }
+  for (auto &child : router.routers_)
+    collectRoutes(*child.second, parents + mountpath, routes, paths);
+}
+
+/// @brief a label value, with backslash, double quote and newline escaped
+static void writeLabelValue(Print &out, const char *value) {
+  for (; *value; value++) {
+    if (*value == '\\' || *value == '"')
+      out.print('\\');
+    if (*value == '\n')
+      out.print(F("\\n"));
+    else
+      out.print(*value);
+  }
+}
+
+/// @brief {method="GET",route="/path"
+static void writeLabels(Print &out, const MetricsSource &source) {
+  out.print(F("{method=\""));
+  out.print(source.route ? methodName(source.route->method) : "");
+  out.print(F("\",route=\""));
+  if (source.route)
+    writeLabelValue(out, source.path->length() > 0 ? source.path->c_str()
+                                                   : "/");
+  out.print('"');
+}
+
+/// @brief microseconds as seconds, without floating point
+static void writeSeconds(Print &out, const uint64_t us) {
+  char fraction[8];
+  snprintf(fraction, sizeof(fraction), ".%06u",
+           static_cast<unsigned>(us % 1000000));
+  out.print(static_cast<unsigned long>(us / 1000000));
+  out.print(fraction);
+}
+
+/// @brief
+static void writeType(Print &out, const __FlashStringHelper *name,
+                      const __FlashStringHelper *type,
+                      const __FlashStringHelper *help) {
+  out.print(F("# HELP "));
+  out.print(name);
+  out.print(' ');
+  out.println(help);
+  out.print(F("# TYPE "));
+  out.print(name);
+  out.print(' ');
+  out.println(type);
+}
+
+/// @brief
+static void writeCounter(Print &out, const std::vector<MetricsSource> &sources,
+                         const __FlashStringHelper *name,
+                         const __FlashStringHelper *help,
+                         uint64_t (*value)(const Metrics &)) {
+  writeType(out, name, F("counter"), help);
+  for (auto &source : sources) {
+    out.print(name);
+    writeLabels(out, source);
+    out.print(F("} "));
+    out.println(static_cast<unsigned long long>(value(*source.metrics)));
+  }
+}
+
+/// @brief
+static void writeHistogram(Print &out,
+                           const std::vector<MetricsSource> &sources,
+                           const __FlashStringHelper *name,
+                           const __FlashStringHelper *help,
+                           const Histogram &(*histogram)(const Metrics &)) {
+  writeType(out, name, F("histogram"), help);
+  for (auto &source : sources) {
+    auto &h = histogram(*source.metrics);
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= Histogram::bounds; i++) {
+      cumulative += h.counts[i];
+      out.print(name);
+      out.print(F("_bucket"));
+      writeLabels(out, source);
+      out.print(F(",le=\""));
+      if (i < Histogram::bounds)
+        writeSeconds(out, Histogram::bound(i));
+      else
+        out.print(F("+Inf"));
+      out.print(F("\"} "));
+      out.println(static_cast<unsigned long long>(cumulative));
+    }
+
+    out.print(name);
+    out.print(F("_sum"));
+    writeLabels(out, source);
+    out.print(F("} "));
+    writeSeconds(out, h.sum);
+    out.println();
+
+    out.print(name);
+    out.print(F("_count"));
+    writeLabels(out, source);
+    out.print(F("} "));
+    out.println(static_cast<unsigned long long>(cumulative));
+  }
+}
+
+/// @brief Writes the metrics of all routes straight into the response output,
+/// there is no need to build the (large) text in memory.
+auto _Express::writeMetrics(_Request &req, _Response &res,
+                            const NextCallback) -> void {
+  std::vector<const _Route *> routes;
+  std::vector<String> paths;
+  collectRoutes(*req.app.router_, String(), routes, paths);
+
+  std::vector<MetricsSource> sources;
+  sources.reserve(routes.size() + 1);
+  for (size_t i = 0; i < routes.size(); i++)
+    sources.push_back({routes[i], &routes[i]->metrics, &paths[i]});
+  sources.push_back({nullptr, &req.app.unmatched_, nullptr});
+
+  auto &out = res.out_;
+  res.status_ = HttpStatus::OK;
+
+  out.println(F("HTTP/1.1 200"));
+  out.println(F("Content-Type: text/plain; version=0.0.4"));
+  out.println(F("connection: close"));
+  out.println();
+  res.headersSent = true;
+
+  writeCounter(out, sources, F("express_requests_total"),
+               F("Requests handled."),
+               [](const Metrics &m) -> uint64_t { return m.requests; });
+
+  writeType(out, F("express_responses_total"), F("counter"),
+            F("Responses by status class."));
+  for (auto &source : sources) {
+    for (size_t i = 0; i < 5; i++) {
+      out.print(F("express_responses_total"));
+      writeLabels(out, source);
+      out.print(F(",code=\""));
+      out.print(i + 1);
+      out.print(F("xx\"} "));
+      out.println(source.metrics->statusClasses[i]);
+    }
+  }
+
+  writeCounter(out, sources, F("express_request_bytes_total"),
+               F("Bytes received, request line, headers and body."),
+               [](const Metrics &m) -> uint64_t { return m.bytesIn; });
+  writeCounter(out, sources, F("express_response_bytes_total"),
+               F("Bytes sent."),
+               [](const Metrics &m) -> uint64_t { return m.bytesOut; });
+
+  writeHistogram(out, sources, F("express_parse_seconds"),
+                 F("Time reading the request line and headers."),
+                 [](const Metrics &m) -> const Histogram & { return m.parse; });
+  writeHistogram(
+      out, sources, F("express_dispatch_seconds"),
+      F("Time running middlewares and handlers."),
+      [](const Metrics &m) -> const Histogram & { return m.dispatch; });
+  writeHistogram(out, sources, F("express_send_seconds"),
+                 F("Time writing the response."),
+                 [](const Metrics &m) -> const Histogram & { return m.send; });
+}
+
+/// @brief
+/// @return
+auto _Express::metrics() -> MiddlewareCallback { return writeMetrics; }
+
+END_EXPRESS_NAMESPACE
@@ -0,0 +1,55 @@
+/// @brief Latency histogram with fixed, log-scale buckets: bucket i counts
+/// durations up to 32us << i (32us .. ~1s), the last bucket the rest.
+class Histogram {
+public:
+  static const size_t bounds = 16;
+
+  uint32_t counts[bounds + 1]{};
+  uint64_t sum = 0; // microseconds
+
+  /// @brief
+  /// @return the upper bound of bucket i in microseconds
+  static auto bound(const size_t i) -> uint32_t { return 32u << i; }
+
+  /// @brief
+  /// @param us
+  auto observe(const uint32_t us) -> void {
+    size_t i = 0;
+    while (i < bounds && us > bound(i))
+      i++;
+    counts[i]++;
+    sum += us;
+  }
+};
+
+/// @brief Counters and latency histograms of the requests handled by a route
+/// (or of those no route matched). Preallocated with the route, updating
+/// them does not allocate.
+class Metrics {
+public:
+  uint32_t requests = 0;
+  uint32_t statusClasses[5]{}; // 1xx .. 5xx
+  uint64_t bytesIn = 0;
+  uint64_t bytesOut = 0;
+
+  /// @brief reading the request line and headers
+  Histogram parse{};
+  /// @brief running the middlewares and handlers
+  Histogram dispatch{};
+  /// @brief writing the response
+  Histogram send{};
+
+  /// @brief
+  auto record(const uint16_t status, const size_t in, const size_t out,
+              const uint32_t parseUs, const uint32_t dispatchUs,
+              const uint32_t sendUs) -> void {
+    requests++;
+    if (status >= 100 && status < 600)
+      statusClasses[status / 100 - 1]++;
+    bytesIn += in;
+    bytesOut += out;
+    parse.observe(parseUs);
+    dispatch.observe(dispatchUs);
+    send.observe(sendUs);
+  }
+};
@@ -0,0 +1,74 @@
+#ifndef EXPRESS_OUTPUT_BUFFER_SIZE
+#define EXPRESS_OUTPUT_BUFFER_SIZE 1460 // TCP MSS on Ethernet
+#endif
+
+constexpr size_t outputBufferSize = EXPRESS_OUTPUT_BUFFER_SIZE;
+
+/// @brief Collects small writes (status line, headers, rendered fragments)
+/// into segment sized chunks before handing them to the client. Writes that
+/// do not fit in the remaining space flush first, writes larger than the
+/// buffer go to the client directly.
+///
+/// Everything written can be copied to a tee as well, and the client can be
+/// muted so that only the tee sees the output.
+class OutputBuffer : public Print {
+private:
+  Print &out_;
+  uint8_t buffer_[outputBufferSize];
+  size_t length_ = 0;
+
+  Print *tee_ = nullptr;
+  bool muted_ = false;
+
+public:
+  /// @brief total number of bytes written to the client (not while muted)
+  size_t written = 0;
+
+  OutputBuffer(Print &out) : out_(out) {}
+
+  /// @brief Copies all further writes to tee (nullptr: stop copying). A muted
+  /// buffer only writes to the tee.
+  auto tee(Print *tee, const bool muted = false) -> void {
+    tee_ = tee;
+    muted_ = muted;
+  }
+
+  using Print::write;
+
+  size_t write(uint8_t c) override {
+    if (length_ == sizeof(buffer_))
+      flush();
+    buffer_[length_++] = c;
+    if (!muted_)
+      written++;
+    if (tee_)
+      tee_->write(c);
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t size) override {
+    if (tee_)
+      tee_->write(data, size);
+    if (length_ + size > sizeof(buffer_)) {
+      flush();
+      if (size >= sizeof(buffer_)) {
+        if (muted_)
+          return size;
+        written += size;
+        return out_.write(data, size);
+      }
+    }
+    memcpy(buffer_ + length_, data, size);
+    length_ += size;
+    if (!muted_)
+      written += size;
+    return size;
+  }
+
+  /// @brief Sends what is buffered to the client
+  void flush() override {
+    if (length_ > 0 && !muted_)
+      out_.write(buffer_, length_);
+    length_ = 0;
+  }
+};
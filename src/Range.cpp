@@ -1,67 +1,74 @@
+#define LOG_MODULE LOG_MODULE_REQUEST
 #include "Express.h"
 
 BEGIN_EXPRESS_NAMESPACE
 
-///
-const Range &_Request::rangeParse(const String &str, const size_t &maxSize) {
-  auto range_ = new Range();
+/// @brief Parses the digits at p, saturating
+/// @return false when there are none
+static auto digits(const char *&p, size_t &value) -> bool {
+  if (*p < '0' || *p > '9')
+    return false;
+  value = 0;
+  while (*p >= '0' && *p <= '9') {
+    size_t digit = *p++ - '0';
+    value = (value > (SIZE_MAX - digit) / 10) ? SIZE_MAX : value * 10 + digit;
+  }
+  return true;
+}
 
-  if (str.length() < 3)
-    return *range_;
+/// @brief Parses a Range header (bytes=0-499,1000-,-500) against a resource
+/// of maxSize bytes, like range-parser: ends past the resource are clamped to
+/// its last byte, a suffix (-500) is the last bytes of the resource, and
+/// ranges that start past its end are left out.
+/// @return type is "" when the header is malformed (or its ranges overlap)
+/// and should be ignored. ranges is empty when none of them is satisfiable.
+auto _Request::rangeParse(const String &str, const size_t &maxSize) -> Range {
+  Range range_;
 
   auto index = str.indexOf('=');
-  if (index < 0)
-    return *range_;
-
-  size_t sum = 0;
-
-  range_->type = str.substring(0, index); // before = (type)
-  auto ranges = str.substring(index + 1); // after =
-
-  index = ranges.indexOf(',');
-  while (index >= 0) {
-    auto range = ranges.substring(0, index); // before ,
-    ranges = ranges.substring(index + 1);    // after ,
-
-    index = range.indexOf('-');
-    if (index >= 0) {
-      auto start = range.substring(0, index).toInt(); // before ,
-      auto end = range.substring(index + 1).toInt();  // after ,
-
+  if (index <= 0)
+    return range_;
+
+  auto p = str.c_str() + index + 1;
+  while (true) {
+    while (*p == ' ')
+      p++;
+
+    size_t start = 0, end = 0;
+    auto hasStart = digits(p, start);
+    if (*p++ != '-')
+      return Range();
+    auto hasEnd = digits(p, end);
+
+    while (*p == ' ')
+      p++;
+    if ((*p != ',' && *p != '\0') || (!hasStart && !hasEnd) ||
+        (hasStart && hasEnd && end < start))
+      return Range();
+
+    if (!hasStart) { // suffix: the last end bytes
+      start = (end >= maxSize) ? 0 : maxSize - end;
+      end = maxSize - 1;
+    } else if (!hasEnd || end >= maxSize)
+      end = maxSize - 1;
+
+    if (start < maxSize) {
       // check if start is bigger than end of the previous
-      if (range_->ranges.size() > 0)
-        if (start <= range_->ranges.back().end)
-          throw new _Error("volgende probleem");
-
-      if (sum + (end - start + 1) >= maxSize) {
-        end = (maxSize - sum + start - 1);
-        range_->ranges.push_back({start, end});
-        return *range_; // we have reached the max amount of bytes, leave here
+      if (!range_.ranges.empty() &&
+          start <= static_cast<size_t>(range_.ranges.back().end)) {
+        LOG_V(F("overlapping ranges, ignored:"), str);
+        return Range();
       }
-
-      sum += (end - start + 1);
-
-      range_->ranges.push_back({start, end});
-    }
-
-    index = ranges.indexOf(',');
-  }
-
-  index = ranges.indexOf('-');
-  if (index >= 0) {
-    auto start = ranges.substring(0, index).toInt(); // before ,
-    auto end = ranges.substring(index + 1).toInt();  // after ,
-    if (end == 0)
-      end = INT_MAX;
-
-    if (sum + (end - start + 1) >= maxSize) {
-      end = (maxSize - sum + start - 1);
+      range_.ranges.push_back(
+          {static_cast<int>(start), static_cast<int>(end)});
     }
 
-    range_->ranges.push_back({start, end});
+    if (*p++ == '\0')
+      break;
   }
 
-  return *range_;
+  range_.type = str.substring(0, index); // before = (type)
+  return range_;
 }
 
 END_EXPRESS_NAMESPACE
@@ -0,0 +1,192 @@
+/// @brief Output of render engines, keyed by a fingerprint of the template
+/// and the locals it was rendered with. The least recently used entries are
+/// dropped to stay within capacity bytes. A capacity of 0 (the default)
+/// disables the cache.
+///
+/// Only enable it when rendered output depends on nothing but the template
+/// and its locals (eg no mustache::list() sections).
+///
+/// Entries can carry a tag, to remove related entries at once.
+class RenderCache {
+public:
+  /// @brief
+  struct Entry {
+    uint64_t fingerprint;
+    std::vector<uint8_t> bytes;
+    uint32_t used;
+    uint32_t stored; // millis() when put
+    uint32_t tag;
+  };
+
+private:
+  std::vector<Entry> entries_{};
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+  uint32_t clock_ = 0;
+
+  /// @brief drop least recently used entries until needed bytes fit
+  auto evict(const size_t needed) -> void {
+    while (!entries_.empty() && size_ + needed > capacity_) {
+      size_t lru = 0;
+      for (size_t i = 1; i < entries_.size(); i++)
+        if (entries_[i].used < entries_[lru].used)
+          lru = i;
+      size_ -= entries_[lru].bytes.size();
+      entries_.erase(entries_.begin() + lru);
+    }
+  }
+
+public:
+  /// @brief FNV-1a (64 bit), can be chained over several fragments
+  static uint64_t hash(const void *data, size_t length,
+                       uint64_t h = 14695981039346656037ull) {
+    auto p = static_cast<const uint8_t *>(data);
+    while (length--) {
+      h ^= *p++;
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  /// @brief
+  /// @return the capacity in bytes, 0 when disabled
+  auto capacity() const -> size_t { return capacity_; }
+
+  /// @brief Sets the capacity in bytes, 0 disables (and empties) the cache
+  /// @param bytes
+  auto capacity(const size_t bytes) -> void {
+    capacity_ = bytes;
+    evict(0);
+  }
+
+  /// @brief
+  /// @return bytes in use
+  auto size() const -> size_t { return size_; }
+
+  /// @brief
+  auto clear() -> void {
+    entries_.clear();
+    size_ = 0;
+  }
+
+  /// @brief Identifies a template (by its content) rendered with locals.
+  static auto fingerprint(const File &file, const Locals &locals)
+      -> uint64_t {
+    auto data = file.data();
+    auto length = file.length();
+
+    auto h = hash(&data, sizeof(data));
+    h = hash(&length, sizeof(length), h);
+    for (size_t i = 0; i < locals.size(); i++) {
+      h = hash(&i, sizeof(i), h); // layer separator
+      for (auto &local : locals.layer(i)) {
+        // including the terminating \0 separates key and value
+        h = hash(local.first.c_str(), local.first.length() + 1, h);
+        h = hash(local.second.c_str(), local.second.length() + 1, h);
+      }
+    }
+    return h;
+  }
+
+  /// @brief
+  /// @return the entry, or nullptr when not cached
+  auto get(const uint64_t fingerprint) -> const Entry * {
+    for (auto &entry : entries_) {
+      if (entry.fingerprint == fingerprint) {
+        entry.used = ++clock_;
+        return &entry;
+      }
+    }
+    return nullptr;
+  }
+
+  /// @brief Stores rendered output, unless it is larger than the capacity.
+  /// An existing entry for fingerprint is replaced.
+  auto put(const uint64_t fingerprint, std::vector<uint8_t> &&bytes,
+           const uint32_t tag = 0) -> void {
+    if (bytes.size() > capacity_)
+      return;
+
+    remove(fingerprint);
+    evict(bytes.size());
+
+    size_ += bytes.size();
+    entries_.push_back(
+        {fingerprint, std::move(bytes), ++clock_,
+         static_cast<uint32_t>(millis()), tag});
+  }
+
+  /// @brief
+  /// @return true when an entry was removed
+  auto remove(const uint64_t fingerprint) -> bool {
+    for (size_t i = 0; i < entries_.size(); i++) {
+      if (entries_[i].fingerprint == fingerprint) {
+        size_ -= entries_[i].bytes.size();
+        entries_.erase(entries_.begin() + i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// @brief Removes all entries put with tag
+  /// @return the number of entries removed
+  auto removeTag(const uint32_t tag) -> size_t {
+    size_t removed = 0;
+    for (size_t i = entries_.size(); i-- > 0;) {
+      if (entries_[i].tag == tag) {
+        size_ -= entries_[i].bytes.size();
+        entries_.erase(entries_.begin() + i);
+        removed++;
+      }
+    }
+    return removed;
+  }
+};
+
+/// @brief Passes writes on to out, keeping a copy of up to limit bytes.
+/// Without out the writes are only captured.
+class RenderCapture : public Print {
+private:
+  Print *out_;
+  size_t limit_;
+
+public:
+  /// @brief
+  std::vector<uint8_t> bytes{};
+
+  /// @brief more than limit bytes were written, bytes is incomplete
+  bool overflow = false;
+
+  RenderCapture(Print &out, const size_t limit) : out_(&out), limit_(limit) {}
+
+  explicit RenderCapture(const size_t limit) : out_(nullptr), limit_(limit) {}
+
+  /// @brief Starts over with no bytes captured and a new limit
+  auto reset(const size_t limit) -> void {
+    bytes.clear();
+    overflow = false;
+    limit_ = limit;
+  }
+
+  using Print::write;
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+
+  size_t write(const uint8_t *data, size_t size) override {
+    if (!overflow) {
+      if (bytes.size() + size > limit_) {
+        overflow = true;
+        bytes.clear();
+        bytes.shrink_to_fit();
+      } else
+        bytes.insert(bytes.end(), data, data + size);
+    }
+    return out_ ? out_->write(data, size) : size;
+  }
+
+  void flush() override {
+    if (out_)
+      out_->flush();
+  }
+};
@@ -0,0 +1,198 @@
+/*!
+ *  @file       Static.cpp
+ *  Project     Arduino Express Library
+ *  @brief      Fast, unopinionated, (very) minimalist web framework for Arduino
+ *  @author     lathoub
+ *  @date       20/01/23
+ *  @license    GNU GENERAL PUBLIC LICENSE
+ *
+ *   Fast, unopinionated, (very) minimalist web framework for Arduino.
+ *   Copyright (C) 2023 lathoub
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define LOG_MODULE LOG_MODULE_MIDDLEWARE
+#include "Express.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+// static declarations
+_Express::StaticAssets _Express::staticAssets_[EXPRESS_STATIC_INSTANCES]{};
+size_t _Express::staticCount_ = 0;
+
+template <>
+auto _Express::serveStaticAt<EXPRESS_STATIC_INSTANCES>(const size_t)
+    -> MiddlewareCallback {
+  return nullptr;
+}
+
+/// @brief stands in for Static() middlewares that could not be created
+static auto passThrough(_Request &, _Response &, const NextCallback next)
+    -> void {
+  next(nullptr);
+}
+
+/// @brief
+/// @param assets
+/// @param req
+/// @param res
+/// @return
+auto _Express::serveStatic(const StaticAssets &assets, _Request &req,
+                           _Response &res, const NextCallback next) -> void {
+  auto &options = assets.options;
+
+  if (req.method_ != Method::GET && req.method_ != Method::HEAD) {
+    next(nullptr);
+    return;
+  }
+
+  // below the path the middleware is mounted on
+  auto path = req.uri.c_str() + req.baseUrl.length();
+  auto len = req.uri.length() - req.baseUrl.length();
+
+  // a path segment starting with a dot
+  if (strstr(path, "/.") != nullptr) {
+    if (options.dotfiles.equalsIgnoreCase(F("deny"))) {
+      res.sendStatus(HttpStatus::FORBIDDEN);
+      return;
+    }
+    if (!options.dotfiles.equalsIgnoreCase(F("allow"))) {
+      next(nullptr);
+      return;
+    }
+  }
+
+  const Asset *asset = nullptr;
+  if (len == 0 || path[len - 1] == '/') {
+    if (options.index.length() > 0) {
+      String indexPath = path;
+      if (len == 0 || path[len - 1] != '/')
+        indexPath += '/';
+      indexPath += options.index;
+      asset = assets.index.find(options.root, indexPath.c_str(),
+                                indexPath.length());
+    }
+  } else
+    asset = assets.index.find(options.root, path, len);
+
+  if (!asset) {
+    next(nullptr);
+    return;
+  }
+
+  LOG_V(F("static asset"), asset->path, asset->length);
+
+  res.status(HttpStatus::OK);
+
+  for (auto [key, header] : options.headers)
+    res.headers[key] = header;
+
+  res.headers[ContentType] = asset->mime;
+
+  auto offset = asset->offset;
+  size_t length = asset->length;
+  auto etag = asset->etag;
+
+  if (asset->gzipLength > 0) {
+    res.headers[F("vary")] = F("Accept-Encoding");
+
+    static const char gzip[] = "gzip";
+    auto acceptEncoding = req.headers.find(F("accept-encoding"));
+    if (acceptEncoding != req.headers.end() &&
+        MediaType::quality(acceptEncoding->second.c_str(), gzip,
+                           gzip + sizeof(gzip) - 1) > 0) {
+      offset = asset->gzipOffset;
+      length = asset->gzipLength;
+      etag = asset->gzipEtag;
+      res.headers[F("content-encoding")] = F("gzip");
+    }
+  }
+
+  if (options.cacheControl) {
+    String cacheControl = F("public, max-age=");
+    cacheControl += options.maxAge / 1000;
+    if (options.immutable)
+      cacheControl += F(", immutable");
+    res.headers[F("cache-control")] = cacheControl;
+  }
+
+  if (etag) {
+    res.headers[F("etag")] = etag;
+
+    auto ifNoneMatch = req.headers.find(F("if-none-match"));
+    if (ifNoneMatch != req.headers.end() && ifNoneMatch->second.equals(etag)) {
+      res.status(HttpStatus::NOT_MODIFIED);
+      return;
+    }
+  }
+
+  size_t first = 0;
+
+  if (options.acceptRanges) {
+    res.headers[F("accept-ranges")] = F("bytes");
+
+    auto header = req.headers.find(F("range"));
+    if (header != req.headers.end() && length > 0) {
+      auto range = _Request::rangeParse(header->second, length);
+      if (range.type == F("bytes") && range.ranges.empty()) {
+        res.status(HttpStatus::RANGE_NOT_SATISFIABLE);
+        res.headers[F("content-range")] = String(F("bytes */")) + length;
+        return;
+      }
+      // several ranges (no multipart/byteranges) or a malformed header: the
+      // whole asset
+      if (range.type == F("bytes") && range.ranges.size() == 1) {
+        first = range.ranges[0].start;
+        size_t last = range.ranges[0].end;
+        res.status(HttpStatus::PARTIAL_CONTENT);
+        res.headers[F("content-range")] = String(F("bytes ")) + first + F("-") +
+                                          last + F("/") + length;
+        length = last - first + 1;
+      }
+    }
+  }
+
+  res.headers[ContentLength] = String(length);
+
+  if (req.method_ == Method::GET) {
+    res.bodyData_ = assets.index.data() + offset + first;
+    res.bodyLength_ = length;
+  }
+}
+
+/// @brief This is a built-in middleware function in _Express. It serves
+/// static files and is based on serve-static. The bundle is not copied and
+/// must outlive the app (typically a global const).
+/// @param bundle
+/// @param options
+/// @return a MiddlewareCallback. When all EXPRESS_STATIC_INSTANCES are in
+/// use, one that serves nothing.
+auto _Express::Static(const AssetBundle &bundle, const Options &options)
+    -> MiddlewareCallback {
+  LOG_I(F("Static, assets:"), bundle.count);
+
+  if (staticCount_ == EXPRESS_STATIC_INSTANCES) {
+    LOG_E(F("Static: increase EXPRESS_STATIC_INSTANCES"));
+    return passThrough;
+  }
+
+  auto &assets = staticAssets_[staticCount_];
+  assets.index.build(bundle);
+  assets.options = options;
+
+  return serveStaticAt<0>(staticCount_++);
+}
+
+END_EXPRESS_NAMESPACE
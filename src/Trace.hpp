@@ -0,0 +1,75 @@
+/// @brief Request lifecycle tracing. Compiled in only when EXPRESS_TRACE is
+/// defined for the library build (eg -DEXPRESS_TRACE in build flags),
+/// otherwise the trace points expand to nothing.
+///
+/// While a request is handled every phase stores its begin and end time
+/// (micros()) in Trace::record. After the response is sent the record, with
+/// the matched route, is handed to the callback set with Trace::hook().
+#ifdef EXPRESS_TRACE
+
+class _Route;
+
+/// @brief
+enum class TracePhase : uint8_t {
+  Parse,       // _Request::parse()
+  Middlewares, // router wide middlewares, in _Router::dispatch()
+  Match,       // finding the route, in _Router::evaluate()
+  Route,       // the middlewares and handlers of the matched route
+  Headers,     // status line and headers, evaluateHeaders() included
+  Body,        // sendBody()
+};
+
+constexpr size_t tracePhases = 6;
+
+/// @brief begin and end times of the phases of one request, 0 when a phase
+/// did not run
+struct TraceRecord {
+  uint32_t begin[tracePhases];
+  uint32_t end[tracePhases];
+  const _Route *route; // nullptr when no route matched
+};
+
+using TraceCallback = void (*)(const TraceRecord &);
+
+/// @brief
+class Trace {
+public:
+  static TraceRecord record;
+  static TraceCallback callback;
+
+  /// @brief Sets the callback that receives the record of every request
+  static auto hook(const TraceCallback cb) -> void { callback = cb; }
+
+  static auto begin(const TracePhase phase) -> void {
+    record.begin[static_cast<size_t>(phase)] = micros();
+  }
+
+  static auto end(const TracePhase phase) -> void {
+    record.end[static_cast<size_t>(phase)] = micros();
+  }
+
+  /// @brief
+  static auto start() -> void { memset(&record, 0, sizeof(record)); }
+
+  /// @brief
+  static auto finish() -> void {
+    if (callback)
+      callback(record);
+  }
+};
+
+#define EXPRESS_TRACE_START() Trace::start()
+#define EXPRESS_TRACE_BEGIN(phase) Trace::begin(TracePhase::phase)
+#define EXPRESS_TRACE_END(phase) Trace::end(TracePhase::phase)
+#define EXPRESS_TRACE_ROUTE(r) Trace::record.route = (r)
+#define EXPRESS_TRACE_FINISH() Trace::finish()
+
+#else
+
+#define EXPRESS_TRACE_START() ((void)0)
+#define EXPRESS_TRACE_BEGIN(phase) ((void)0)
+#define EXPRESS_TRACE_END(phase) ((void)0)
+#define EXPRESS_TRACE_ROUTE(r) ((void)0)
+#define EXPRESS_TRACE_FINISH() ((void)0)
+
+#endif
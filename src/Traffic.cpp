@@ -0,0 +1,256 @@
+/*!
+ *  @file       Traffic.cpp
+ *  Project     Arduino Express Library
+ *  @brief      Fast, unopinionated, (very) minimalist web framework for Arduino
+ *  @author     lathoub
+ *  @date       20/01/23
+ *  @license    GNU GENERAL PUBLIC LICENSE
+ *
+ *   Fast, unopinionated, (very) minimalist web framework for Arduino.
+ *   Copyright (C) 2023 lathoub
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define LOG_MODULE LOG_MODULE_EXPRESS
+#include "Express.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief
+/// @param capacity
+TrafficRecorder::TrafficRecorder(const size_t capacity) : ring_(capacity) {}
+
+/// @brief
+/// @param out
+TrafficRecorder::TrafficRecorder(Print &out) : out_(&out) {
+  out.write(reinterpret_cast<const uint8_t *>("EXTR"), 4);
+  out.write(version);
+}
+
+/// @brief
+auto TrafficRecorder::open() -> void { record(Open, nullptr, 0, micros()); }
+
+/// @brief
+/// @param data
+/// @param length
+/// @param when micros() of the first byte
+auto TrafficRecorder::data(const uint8_t *data, const size_t length,
+                           const uint32_t when) -> void {
+  record(Data, data, length, when);
+}
+
+/// @brief
+auto TrafficRecorder::close() -> void { record(Close, nullptr, 0, micros()); }
+
+/// @brief
+/// @param out
+auto TrafficRecorder::dump(Print &out) const -> void {
+  out.write(reinterpret_cast<const uint8_t *>("EXTR"), 4);
+  out.write(version);
+
+  if (used_ == 0)
+    return;
+
+  auto tail = (head_ + ring_.size() - used_) % ring_.size();
+  if (tail < head_) {
+    out.write(ring_.data() + tail, used_);
+  } else {
+    out.write(ring_.data() + tail, ring_.size() - tail);
+    out.write(ring_.data(), head_);
+  }
+}
+
+/// @brief
+auto TrafficRecorder::clear() -> void {
+  head_ = 0;
+  used_ = 0;
+  dropped_ = 0;
+  started_ = false;
+}
+
+/// @brief
+/// @param type
+/// @param data
+/// @param length
+/// @param when
+auto TrafficRecorder::record(const Record type, const uint8_t *data,
+                             const size_t length, const uint32_t when)
+    -> void {
+  uint8_t header[11];
+  size_t n = 0;
+  header[n++] = type;
+  n += varint(header + n, started_ ? when - last_ : 0);
+  n += varint(header + n, length);
+
+  last_ = when;
+  started_ = true;
+
+  if (out_) {
+    out_->write(header, n);
+    if (length > 0)
+      out_->write(data, length);
+    return;
+  }
+
+  if (n + length > ring_.size()) {
+    dropped_++;
+    return;
+  }
+
+  while (ring_.size() - used_ < n + length)
+    drop();
+
+  append(header, n);
+  append(data, length);
+}
+
+/// @brief
+/// @param data
+/// @param length
+auto TrafficRecorder::append(const uint8_t *data, const size_t length)
+    -> void {
+  for (size_t i = 0; i < length; i++) {
+    ring_[head_] = data[i];
+    head_ = (head_ + 1) % ring_.size();
+  }
+  used_ += length;
+}
+
+/// @brief Drops the oldest record.
+auto TrafficRecorder::drop() -> void {
+  auto tail = head_ + ring_.size() - used_;
+  auto offset = tail + 1; // type
+  varintAt(offset);       // delta
+  auto length = varintAt(offset);
+
+  used_ -= offset - tail + length;
+  dropped_++;
+}
+
+/// @brief
+/// @param offset from the start of the ring, may be past its end
+/// @return
+auto TrafficRecorder::at(const size_t offset) const -> uint8_t {
+  return ring_[offset % ring_.size()];
+}
+
+/// @brief
+/// @param offset moved past the varint
+/// @return
+auto TrafficRecorder::varintAt(size_t &offset) const -> uint32_t {
+  uint32_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    auto byte = at(offset++);
+    value |= uint32_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+}
+
+/// @brief
+/// @param out room for 5 bytes
+/// @param value
+/// @return number of bytes written
+auto TrafficRecorder::varint(uint8_t *out, uint32_t value) -> size_t {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = uint8_t(value) | 0x80;
+    value >>= 7;
+  }
+  out[n++] = uint8_t(value);
+  return n;
+}
+
+/// @brief
+/// @param client
+/// @param recorder
+TrafficTap::TrafficTap(ClientType &client, TrafficRecorder &recorder)
+    : ClientType(client), client_(client), recorder_(recorder) {
+  recorder_.open();
+}
+
+/// @brief
+TrafficTap::~TrafficTap() {
+  flushPending();
+  recorder_.close();
+}
+
+/// @brief
+/// @return
+int TrafficTap::read() {
+  auto c = client_.read();
+  if (c >= 0) {
+    uint8_t byte = c;
+    tap(&byte, 1);
+  }
+  return c;
+}
+
+/// @brief
+/// @param buffer
+/// @param size
+/// @return
+int TrafficTap::read(uint8_t *buffer, size_t size) {
+  auto n = client_.read(buffer, size);
+  if (n > 0)
+    tap(buffer, n);
+  return n;
+}
+
+/// @brief
+/// @param c
+/// @return
+size_t TrafficTap::write(uint8_t c) {
+  flushPending();
+  return client_.write(c);
+}
+
+/// @brief
+/// @param buffer
+/// @param size
+/// @return
+size_t TrafficTap::write(const uint8_t *buffer, size_t size) {
+  flushPending();
+  return client_.write(buffer, size);
+}
+
+/// @brief Gathers read bytes. A pause of more than a millisecond between
+/// reads starts a new record, so the log keeps how the bytes arrived.
+/// @param data
+/// @param length
+auto TrafficTap::tap(const uint8_t *data, const size_t length) -> void {
+  auto now = micros();
+  if (pendingLength_ > 0 && now - pendingLast_ > 1000)
+    flushPending();
+  pendingLast_ = now;
+
+  for (size_t i = 0; i < length; i++) {
+    if (pendingLength_ == 0)
+      pendingSince_ = now;
+    pending_[pendingLength_++] = data[i];
+    if (pendingLength_ == sizeof(pending_))
+      flushPending();
+  }
+}
+
+/// @brief
+auto TrafficTap::flushPending() -> void {
+  if (pendingLength_ == 0)
+    return;
+  recorder_.data(pending_, pendingLength_, pendingSince_);
+  pendingLength_ = 0;
+}
+
+END_EXPRESS_NAMESPACE
@@ -0,0 +1,114 @@
+/// @brief Records the raw bytes clients send, with their timing, so a field
+/// problem can be replayed on a host (see extras/replay). Enable with
+/// app.record(&recorder); the recorder keeps the log in a RAM ring, dropping
+/// the oldest records when full, or streams it to a Print as it goes.
+///
+/// Log format, all integers unsigned LEB128 varints:
+///
+///     header  "EXTR" version(1 byte)
+///     record  type(1 byte) delta length data
+///
+/// delta is the number of microseconds since the previous record, type is
+/// Open (a connection was accepted), Data (length bytes read from it) or
+/// Close. Open and Close have a length of 0.
+class TrafficRecorder {
+public:
+  enum Record : uint8_t {
+    Open = 1,
+    Data = 2,
+    Close = 3,
+  };
+
+  static const uint8_t version = 1;
+
+  /// @brief keeps the log in RAM, in a ring of capacity bytes, allocated here
+  /// @param capacity
+  explicit TrafficRecorder(const size_t capacity);
+
+  /// @brief streams the log to out, starting with the header
+  /// @param out
+  explicit TrafficRecorder(Print &out);
+
+  /// @brief
+  auto open() -> void;
+  /// @brief
+  auto data(const uint8_t *data, const size_t length, const uint32_t when)
+      -> void;
+  /// @brief
+  auto close() -> void;
+
+  /// @brief Writes the header and the records held in RAM, oldest first.
+  /// @param out
+  auto dump(Print &out) const -> void;
+
+  /// @brief
+  /// @return number of bytes held in RAM
+  auto size() const -> size_t { return used_; }
+
+  /// @brief
+  /// @return number of records dropped to make room for newer ones
+  auto dropped() const -> uint32_t { return dropped_; }
+
+  /// @brief Forgets the records held in RAM.
+  auto clear() -> void;
+
+private:
+  std::vector<uint8_t> ring_{};
+  size_t head_ = 0; // where the next byte goes
+  size_t used_ = 0;
+  uint32_t dropped_ = 0;
+
+  Print *out_ = nullptr;
+
+  uint32_t last_ = 0;
+  bool started_ = false;
+
+  auto record(const Record type, const uint8_t *data, const size_t length,
+              const uint32_t when) -> void;
+  auto append(const uint8_t *data, const size_t length) -> void;
+  auto drop() -> void;
+  auto at(const size_t offset) const -> uint8_t;
+  auto varintAt(size_t &offset) const -> uint32_t;
+
+  static auto varint(uint8_t *out, uint32_t value) -> size_t;
+};
+
+/// @brief A client that passes everything through to the accepted client
+/// and hands what is read from it to a TrafficRecorder. Reads are gathered
+/// into one Data record until there is a pause in the reads, the record is
+/// full, or the response starts.
+class TrafficTap : public ClientType {
+private:
+  ClientType &client_;
+  TrafficRecorder &recorder_;
+
+  uint8_t pending_[128];
+  size_t pendingLength_ = 0;
+  uint32_t pendingSince_ = 0; // micros() of the first pending byte
+  uint32_t pendingLast_ = 0;  // and of the last
+
+  auto tap(const uint8_t *data, const size_t length) -> void;
+  auto flushPending() -> void;
+
+public:
+  /// @brief Copies client, so members that are not virtual (eg remoteIP())
+  /// work on the same connection, and records the connection as opened.
+  TrafficTap(ClientType &client, TrafficRecorder &recorder);
+
+  /// @brief records the connection as closed
+  ~TrafficTap();
+
+  int available() override { return client_.available(); }
+  int read() override;
+  int read(uint8_t *buffer, size_t size) override;
+  int peek() override { return client_.peek(); }
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+
+  void flush() override { client_.flush(); }
+  void stop() override { client_.stop(); }
+  uint8_t connected() override { return client_.connected(); }
+  operator bool() override { return static_cast<bool>(client_); }
+};
@@ -53,8 +53,15 @@ typedef uint8_t byte;
 #define ClientType WiFiClient
 #endif
 
+// The library logs up to LOG_LOGLEVEL_INFO, unless built with another
+// LOG_LOGLEVEL (eg -DLOG_LOGLEVEL=7 for verbose). What is compiled in can be
+// lowered at runtime with Logger::level().
+#ifndef LOGGER
 #define LOGGER Serial
-#define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+#endif
+#ifndef LOG_LOGLEVEL
+#define LOG_LOGLEVEL LOG_LOGLEVEL_INFO
+#endif
 
 #include "utility/logger.h"
 
@@ -94,13 +101,106 @@ const String __dirname{};
 using ContentCallback = const char *(*)();
 using WriteCallback = void (*)(const char *, int);
 
+/// @brief Read-only, layered view of locals: the first layer that has a name
+/// wins. Layers are referenced, not copied.
+class Locals {
+private:
+  static const size_t maxLayers = 3;
+  const locals_t *layers_[maxLayers]{};
+  size_t count_ = 0;
+
+public:
+  Locals() {}
+
+  /// @brief
+  /// @param locals the top layer
+  Locals(const locals_t &locals) { push(locals); }
+
+  /// @brief Adds a layer below the existing ones.
+  /// @param locals
+  /// @return
+  auto push(const locals_t &locals) -> Locals & {
+    if (count_ < maxLayers)
+      layers_[count_++] = &locals;
+    return *this;
+  }
+
+  /// @brief
+  /// @param name
+  /// @return the value of name in the first layer that has it, or nullptr
+  auto find(const String &name) const -> const String * {
+    for (size_t i = 0; i < count_; i++) {
+      auto local = layers_[i]->find(name);
+      if (local != layers_[i]->end())
+        return &local->second;
+    }
+    return nullptr;
+  }
+
+  /// @brief
+  /// @return the number of layers
+  auto size() const -> size_t { return count_; }
+
+  /// @brief
+  /// @param index
+  /// @return layer index, 0 being the top
+  auto layer(const size_t index) const -> const locals_t & {
+    return *layers_[index];
+  }
+};
+
+/// @brief Content with a name. Either NUL-terminated text returned by a
+/// contentsCallback, or binary data with an explicit size. The content is
+/// fetched (and its length measured) only once.
 struct File {
   String filename;
-  ContentCallback contentsCallback;
-  size_t length() { return strlen(contentsCallback()); }
+  ContentCallback contentsCallback{};
+
+  File() {}
+
+  /// @brief text content, the length is taken on first use
+  File(const String &filename, const ContentCallback contentsCallback)
+      : filename(filename), contentsCallback(contentsCallback) {}
+
+  /// @brief binary content (may contain NUL bytes, eg images or firmware)
+  File(const String &filename, const uint8_t *data, const size_t length)
+      : filename(filename), data_(data), length_(length) {}
+
+  /// @brief
+  /// @return the content bytes, not NUL-terminated for binary files
+  const uint8_t *data() const {
+    if (!data_ && contentsCallback)
+      data_ = reinterpret_cast<const uint8_t *>(contentsCallback());
+    return data_;
+  }
+
+  /// @brief
+  /// @return the content length in bytes
+  size_t length() const {
+    if (length_ == SIZE_MAX) {
+      auto content = data();
+      length_ = content ? strlen(reinterpret_cast<const char *>(content)) : 0;
+    }
+    return length_;
+  }
+
+  /// @brief
+  /// @return true when the file has content
+  explicit operator bool() const { return data_ || contentsCallback; }
+
+private:
+  mutable const uint8_t *data_ = nullptr;
+  mutable size_t length_ = SIZE_MAX;
 };
 
 #include "Buffer.hpp"
+#include "Bundle.hpp"
+#include "OutputBuffer.hpp"
+#include "RenderCache.hpp"
+#include "MediaType.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+#include "Traffic.hpp"
 
 /// @brief When std::vector's are not available, an
 /// alternative implementation uses fixed length containers.
@@ -116,15 +216,18 @@ struct Range {
   String type;
   std::vector<beginEnd> ranges;
   String toString() {
+    if (ranges.empty())
+      return String();
+
     String str(type);
     str += F("=");
     for (auto [start, end] : ranges) {
+      if (str[str.length() - 1] != '=')
+        str += F(",");
       str += start;
       str += F("-");
       str += end;
-      str += F(",");
     }
-    str[str.length() - 1] = '\0';
 
     return str;
   }
@@ -153,6 +256,9 @@ public:
   /// Sets the max-age property of the Cache-Control header in milliseconds or
   /// a string in ms format
   String root{};
+  /// Sends the specified directory index file. Set to "" to disable directory
+  /// indexing.
+  String index = F("index.html");
 
   /// @brief Default constructor
   Options() {}
@@ -166,6 +272,7 @@ public:
     this->dotfiles = another->dotfiles;
     this->maxAge = another->maxAge;
     this->root = another->root;
+    this->index = another->index;
   }
 };
 
@@ -174,6 +281,8 @@ struct PosLen {
   size_t len;
 };
 
+#include "Cookies.hpp"
+
 enum Method {
   GET,    // The GET method requests a representation of the specified resource.
           // Requests using GET should only retrieve data.
@@ -239,6 +348,7 @@ enum HttpStatus {
   RANGE_NOT_SATISFIABLE = 416,
   EXPECTATION_FAILED = 417,
   I_AM_A_TEAPOT = 418,
+  TOO_MANY_REQUESTS = 429,
   RETRY_WITH = 449,
 
   SERVER_ERROR = 500,
@@ -23,6 +23,7 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define LOG_MODULE LOG_MODULE_EXPRESS
 #include "Express.h"
 
 BEGIN_EXPRESS_NAMESPACE
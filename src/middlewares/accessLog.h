@@ -0,0 +1,231 @@
+#include "defs.h"
+
+#include <atomic>
+#include <time.h>
+
+BEGIN_EXPRESS_NAMESPACE
+
+enum AccessLogFormat : uint8_t {
+  CommonLogFormat,   // host ident user [date] "request" status bytes
+  CombinedLogFormat, // and "referer" "user-agent"
+};
+
+/// @brief Access log. When the response has been sent (a finish callback,
+/// so also after an error handler answered) the request is recorded as a
+/// fixed size entry in a ring of entries, allocated up front. Nothing is
+/// formatted or printed while handling the request: drain() does that, from
+/// loop() or another task, to any Print (Serial, a File, ...) or hands the
+/// entries to a callback.
+///
+/// Lines are in Common (or Combined) Log Format, followed by the latency in
+/// microseconds:
+///
+///     10.0.0.2 - - [18/Oct/2026:14:05:45 +0000] "GET /api HTTP/1.1" 200 42 870
+///
+/// The date is time(), set the clock (eg configTime()) for it to be right.
+/// A full ring drops new entries, and counts them, rather than holding up
+/// the request. One task records, one drains: the ring is lock-free between
+/// the two.
+///
+/// Each combination of template arguments has its own ring.
+template <uint16_t entries = 16, size_t textSize = 96,
+          AccessLogFormat format = CommonLogFormat>
+class AccessLog {
+  static_assert((entries & (entries - 1)) == 0, "entries must be a power of 2");
+
+public:
+  struct Entry {
+    uint32_t ip;
+    uint32_t time;    // seconds since 1970
+    uint32_t latency; // microseconds from arrival to the response sent
+    uint32_t bytes;   // of the body
+    uint16_t status;
+    // method, uri (and referer, user agent), each NUL terminated, cut to fit
+    char text[textSize];
+  };
+
+  using EntryCallback = void (*)(const Entry &);
+
+private:
+  static Entry entries_[entries];
+  static std::atomic<uint32_t> head_; // written by the request handler
+  static std::atomic<uint32_t> tail_; // written by drain()
+  static std::atomic<uint32_t> dropped_;
+
+  /// @brief appends s as the next field of text, as much as fits
+  static auto append(Entry &entry, size_t &length, const char *s) -> void {
+    if (length == textSize)
+      return;
+    while (*s && length < textSize - 1)
+      entry.text[length++] = *s++;
+    entry.text[length++] = '\0';
+  }
+
+  /// @brief
+  /// @return field i of the text of entry, "" when it did not fit
+  static auto field(const Entry &entry, uint8_t i) -> const char * {
+    size_t offset = 0;
+    for (; i > 0 && offset < textSize; i--)
+      offset += strnlen(entry.text + offset, textSize - offset) + 1;
+    return offset < textSize ? entry.text + offset : "";
+  }
+
+  /// @brief prints s in quotes, escaping quotes and backslashes
+  static auto quoted(Print &out, const char *s) -> void {
+    out.print('"');
+    if (*s == '\0')
+      out.print('-');
+    for (; *s; s++) {
+      if (*s == '"' || *s == '\\')
+        out.print('\\');
+      out.print(*s);
+    }
+    out.print('"');
+  }
+
+  /// @brief finish callback, records the request
+  static auto record(_Request &req, _Response &res) -> void {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == entries) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    auto &entry = entries_[head & (entries - 1)];
+    entry.ip = static_cast<uint32_t>(req.ip);
+    entry.time = static_cast<uint32_t>(::time(nullptr));
+    entry.latency = micros() - req.received;
+    entry.bytes = res.bytesSent();
+    entry.status = res.status_;
+
+    size_t length = 0;
+    append(entry, length, req.method.c_str());
+    // the parser keeps "/" as an empty path
+    append(entry, length, req.uri.length() > 0 ? req.uri.c_str() : "/");
+    if (format == CombinedLogFormat) {
+      auto referer = req.header(F("referer"));
+      append(entry, length, referer ? referer->c_str() : "");
+      auto agent = req.header(F("user-agent"));
+      append(entry, length, agent ? agent->c_str() : "");
+    }
+
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+public:
+  /// @brief
+  static auto handler(_Request &req, _Response &res, const NextCallback next)
+      -> void {
+    if (!res.onFinish(record))
+      LOG_W(F("accessLog: no room for the finish callback"));
+    next(nullptr);
+  }
+
+  /// @brief Prints one entry as a log line.
+  /// @param out
+  /// @param entry
+  static auto print(Print &out, const Entry &entry) -> void {
+    out.print(IPAddress(entry.ip));
+    out.print(F(" - - ["));
+
+    char date[32];
+    time_t seconds = entry.time;
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    strftime(date, sizeof(date), "%d/%b/%Y:%H:%M:%S +0000", &tm);
+    out.print(date);
+
+    out.print(F("] \""));
+    out.print(field(entry, 0));
+    out.print(' ');
+    out.print(field(entry, 1));
+    out.print(F(" HTTP/1.1\" "));
+    out.print(entry.status);
+    out.print(' ');
+    if (entry.bytes > 0)
+      out.print(entry.bytes);
+    else
+      out.print('-');
+
+    if (format == CombinedLogFormat) {
+      out.print(' ');
+      quoted(out, field(entry, 2));
+      out.print(' ');
+      quoted(out, field(entry, 3));
+    }
+
+    out.print(' ');
+    out.println(entry.latency);
+  }
+
+  /// @brief Hands up to max entries, oldest first, to callback and frees
+  /// them. After the last entry, reports how many were dropped.
+  /// @return the number of entries drained
+  static auto drain(const EntryCallback callback, const size_t max = SIZE_MAX)
+      -> size_t {
+    size_t n = 0;
+    auto tail = tail_.load(std::memory_order_relaxed);
+    while (n < max && tail != head_.load(std::memory_order_acquire)) {
+      callback(entries_[tail & (entries - 1)]);
+      tail_.store(++tail, std::memory_order_release);
+      n++;
+    }
+
+    if (tail == head_.load(std::memory_order_acquire))
+      if (auto dropped = dropped_.exchange(0))
+        LOG_W(F("accessLog:"), dropped, F("entries dropped"));
+    return n;
+  }
+
+  /// @brief Prints up to max entries, oldest first, to out.
+  /// @return the number of entries drained
+  static auto drain(Print &out, const size_t max = SIZE_MAX) -> size_t {
+    static Print *sink;
+    sink = &out;
+    return drain([](const Entry &entry) { print(*sink, entry); }, max);
+  }
+
+  /// @brief
+  /// @return entries waiting to be drained
+  static auto size() -> size_t {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+  /// @brief
+  /// @return entries dropped because the ring was full, since the last drain
+  static auto dropped() -> uint32_t { return dropped_.load(); }
+};
+
+template <uint16_t entries, size_t textSize, AccessLogFormat format>
+typename AccessLog<entries, textSize, format>::Entry
+    AccessLog<entries, textSize, format>::entries_[entries] = {};
+template <uint16_t entries, size_t textSize, AccessLogFormat format>
+std::atomic<uint32_t> AccessLog<entries, textSize, format>::head_{0};
+template <uint16_t entries, size_t textSize, AccessLogFormat format>
+std::atomic<uint32_t> AccessLog<entries, textSize, format>::tail_{0};
+template <uint16_t entries, size_t textSize, AccessLogFormat format>
+std::atomic<uint32_t> AccessLog<entries, textSize, format>::dropped_{0};
+
+END_EXPRESS_NAMESPACE
+
+/// @brief Access log middleware. Use it first, so that requests answered by
+/// another middleware are logged as well, and drain it outside of the request
+/// path, eg after app.run() in loop():
+///
+///     app.use(accessLog());
+///     ...
+///     void loop() {
+///       app.run();
+///       AccessLog<>::drain(Serial, 4);
+///     }
+/// @tparam entries size of the ring, a power of 2
+/// @tparam textSize bytes per entry for the method, uri (and referer, user
+/// agent)
+/// @tparam format
+/// @return
+template <uint16_t entries = 16, size_t textSize = 96,
+          AccessLogFormat format = CommonLogFormat>
+static MiddlewareCallback accessLog() {
+  return AccessLog<entries, textSize, format>::handler;
+}
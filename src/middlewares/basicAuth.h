@@ -1,39 +1,144 @@
 #include <Base64.h>
+#include <mbedtls/md.h>
+#include <type_traits>
 
 #include "defs.h"
 
+#ifndef EXPRESS_BASIC_AUTH_INSTANCES
+#define EXPRESS_BASIC_AUTH_INSTANCES 4 // number of basicAuth() calls allowed
+#endif
+
 BEGIN_EXPRESS_NAMESPACE
 
 /// @brief inspired by https://github.com/LionC/_Express-basic-auth
+///
+/// Every basicAuth() call gets its own instance. The credentials are encoded
+/// once, at registration, and only their SHA-256 digests are kept, in a small
+/// open addressing table. A request costs one digest and one table lookup,
+/// or just the digest when its Authorization value was verified recently:
+/// those are remembered by digest too, no credentials are kept in memory.
+/// Digests are compared in constant time.
 class BasicAuth {
-public:
-  static std::map<String, String> users;
-  static bool challenge;
+private:
+  static const size_t digestSize = 32;
+  static const size_t cacheSize = 4; // a power of 2
+  static const size_t maxInstances = EXPRESS_BASIC_AUTH_INSTANCES;
 
-public:
-  static auto auth(_Request &req, _Response &res, const NextCallback next)
+  struct Credential {
+    uint8_t digest[digestSize];
+  };
+
+  std::vector<Credential> credentials_{};
+  std::vector<uint16_t> slots_{}; // credential index + 1, 0 = empty
+  uint16_t mask_ = 0;
+  bool challenge_ = true;
+
+  /// @brief digests of the Authorization values verified recently, direct
+  /// mapped
+  Credential cache_[cacheSize]{};
+
+  static BasicAuth instances_[maxInstances];
+  static size_t count_;
+
+  /// @brief
+  static void digest(const char *token, const size_t length, uint8_t *out) {
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+               reinterpret_cast<const uint8_t *>(token), length, out);
+  }
+
+  /// @brief compares all length bytes, whatever the outcome
+  static bool equals(const uint8_t *a, const uint8_t *b, const size_t length) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < length; i++)
+      diff |= a[i] ^ b[i];
+    return diff == 0;
+  }
+
+  /// @brief the digest is uniformly distributed, its first bytes are the hash
+  auto home(const uint8_t *digest) const -> uint16_t {
+    return (digest[0] | digest[1] << 8) & mask_;
+  }
+
+  /// @brief
+  auto init(const std::map<String, String> &users, const bool challenge)
       -> void {
-    auto basicAuth = req.headers["authorization"]; // basic encodeUserPasswd
-
-    LOG_V(F("BasicAuth::auth"), basicAuth);
-
-    bool authenticated = false;
-    if (basicAuth.startsWith(F("Basic"))) {
-      basicAuth = basicAuth.substring(6);
-      basicAuth.trim();
-
-      for (auto const &user : users) {
-        auto sum = user.first + ":" + user.second;
-        if (base64::encode(sum) == basicAuth) {
-          authenticated = true;
-          break;
-        }
-      }
+    challenge_ = challenge;
+
+    if (users.size() > 0x7FFF) {
+      LOG_E(F("basicAuth: too many users"), users.size());
+      slots_.assign(1, 0); // nobody gets in
+      mask_ = 0;
+      return;
+    }
+
+    uint16_t size = 4;
+    while (size < users.size() * 2)
+      size <<= 1;
+    mask_ = size - 1;
+    slots_.assign(size, 0);
+
+    credentials_.clear();
+    credentials_.reserve(users.size());
+    for (auto const &user : users) {
+      auto token = base64::encode(user.first + ":" + user.second);
+
+      Credential credential;
+      digest(token.c_str(), token.length(), credential.digest);
+      credentials_.push_back(credential);
+
+      auto slot = home(credential.digest);
+      while (slots_[slot] != 0)
+        slot = (slot + 1) & mask_;
+      slots_[slot] = credentials_.size();
     }
+  }
+
+  /// @brief
+  /// @return true when given, the digest of a token (the base64 part),
+  /// belongs to a user
+  auto verify(const uint8_t *given) const -> bool {
+    for (auto slot = home(given); slots_[slot] != 0;
+         slot = (slot + 1) & mask_)
+      if (equals(credentials_[slots_[slot] - 1].digest, given, digestSize))
+        return true;
+
+    return false;
+  }
 
-    if (!authenticated) {
+  /// @brief
+  auto authenticate(const String *authorization) -> bool {
+    if (!authorization || !authorization->startsWith(F("Basic ")))
+      return false;
+
+    auto token = authorization->c_str() + 6;
+    while (*token == ' ')
+      token++;
+    auto length = authorization->length() - (token - authorization->c_str());
+    while (length > 0 && token[length - 1] == ' ')
+      length--;
+
+    uint8_t given[digestSize];
+    digest(token, length, given);
+
+    // the last bytes pick the cache slot, the first ones the table slot
+    auto &cached = cache_[given[digestSize - 1] & (cacheSize - 1)];
+    if (equals(cached.digest, given, digestSize))
+      return true;
+
+    if (!verify(given))
+      return false;
+
+    memcpy(cached.digest, given, digestSize);
+    return true;
+  }
+
+  /// @brief
+  auto auth(_Request &req, _Response &res, const NextCallback next) -> void {
+    auto authorization = req.header(F("authorization"));
+
+    if (!authenticate(authorization)) {
       LOG_V(F("FAILED AUTH"));
-      if (challenge)
+      if (challenge_)
         res.set("WWW-Authenticate", "Basic");
       res.sendStatus(HttpStatus::DENIED);
       return;
@@ -41,10 +146,53 @@ public:
 
     next(nullptr);
   }
+
+  /// @brief the middleware of instance I
+  template <size_t I>
+  static void handler(_Request &req, _Response &res, const NextCallback next) {
+    instances_[I].auth(req, res, next);
+  }
+
+  /// @brief stands in for instances that could not be created, nobody gets in
+  static void deny(_Request &, _Response &res, const NextCallback) {
+    res.sendStatus(HttpStatus::DENIED);
+  }
+
+  /// @brief handler<i>, for a runtime i
+  template <size_t I> static auto handlerAt(const size_t i) -> MiddlewareCallback {
+    return handlerAt<I>(i, std::integral_constant<bool, I + 1 < maxInstances>());
+  }
+
+  /// @brief
+  template <size_t I>
+  static auto handlerAt(const size_t i, std::true_type) -> MiddlewareCallback {
+    return (i == I) ? handler<I> : handlerAt<I + 1>(i);
+  }
+
+  /// @brief the last instance ends the recursion
+  template <size_t I>
+  static auto handlerAt(const size_t, std::false_type) -> MiddlewareCallback {
+    return handler<I>;
+  }
+
+public:
+  /// @brief Sets up the next instance
+  /// @return its middleware. When all EXPRESS_BASIC_AUTH_INSTANCES are in use,
+  /// a middleware that denies every request.
+  static auto create(const std::map<String, String> &users,
+                     const bool challenge) -> MiddlewareCallback {
+    if (count_ == maxInstances) {
+      LOG_E(F("basicAuth: increase EXPRESS_BASIC_AUTH_INSTANCES"));
+      return deny;
+    }
+
+    instances_[count_].init(users, challenge);
+    return handlerAt<0>(count_++);
+  }
 };
 
-std::map<String, String> BasicAuth::users{};
-bool BasicAuth::challenge = false;
+BasicAuth BasicAuth::instances_[BasicAuth::maxInstances]{};
+size_t BasicAuth::count_ = 0;
 
 END_EXPRESS_NAMESPACE
 
@@ -52,8 +200,5 @@ END_EXPRESS_NAMESPACE
 /// @return
 static MiddlewareCallback basicAuth(const std::map<String, String> &users,
                                     const bool challenge = true) {
-  BasicAuth::users = users;
-  BasicAuth::challenge = challenge;
-
-  return BasicAuth::auth;
+  return BasicAuth::create(users, challenge);
 }
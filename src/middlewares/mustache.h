@@ -1,85 +1,339 @@
-#define LOGGER Serial
-#define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
-
 #include "defs.h"
+#include "utility/htmlEscape.h"
 
 BEGIN_EXPRESS_NAMESPACE
 
-/// @brief
+/// @brief Mustache render engine. Templates are compiled once, on first use,
+/// and cached by their content pointer: template content must be constant
+/// (eg a string literal or flash data).
+///
+/// Supported tags: {{name}} (HTML escaped), {{{name}}} and {{& name}} (raw),
+/// {{#name}}..{{/name}} sections, {{^name}}..{{/name}} inverted sections,
+/// {{> name}} partials and {{! comments}}.
+///
+/// A section iterates over the list registered under its name with
+/// mustache::list(), otherwise it renders once when the local is set and
+/// not empty or "false". Inverted sections render when the list is empty or
+/// the local is not set, empty or "false".
 class mustache {
+public:
+  /// @brief Provides the items of a {{#name}} section, one at a time: fills
+  /// item with the locals of item index and returns true, or returns false
+  /// when there are no more items. Inside the section item locals take
+  /// precedence over the view locals. The item map is reused for every
+  /// item, so set the same keys for each of them.
+  using ListCallback = bool (*)(const size_t index, locals_t &item);
+
 private:
+  enum TokenType : uint8_t {
+    Literal,
+    Variable, // HTML escaped
+    Raw,
+    Section,
+    Inverted,
+    Partial,
+  };
+
+  /// @brief A literal span of the template source, or a tag
+  struct Token {
+    TokenType type;
+    int16_t slot;    // tags: the index in Template::names
+    uint32_t offset; // literal: start in the source, sections: the index
+                     // of the first token after the section
+    uint32_t length; // literal: number of bytes
+  };
+
+  /// @brief A template, compiled on first use
+  struct Template {
+    const char *source;
+    std::vector<Token> tokens;
+    /// @brief distinct tag names, a tag refers to its slot
+    std::vector<String> names;
+  };
+
+  /// @brief max nesting of list sections, and of partials
+  static const size_t maxDepth = 4;
+
   /// @brief
-  /// @return
-  static signed int find(const char *line, const char *ss, const int from,
-                         const int to) {
-    int w = 0;
-    int j = 0;
-    for (auto i = from; i < to; i++) {
-      if (line[i] == ss[j]) {
-        j++;
-        w = i;
-      } else if (w > 0)
-        break; // optimization: stop after equality is found
-    }
+  struct Scope {
+    Print &client;
+    const Locals &locals;
+    size_t depth;    // number of list sections entered
+    size_t partials; // number of partials entered
+  };
+
+  /// @brief compiled templates, keyed on the File content pointer
+  static std::vector<Template *> templates;
+
+  /// @brief locals resolved per slot, reused for every render. Partials
+  /// stack their slots on top of those of the including template.
+  static std::vector<const String *> values;
 
-    return (2 == j) ? w : -1;
+  /// @brief item locals, per list section nesting level
+  static locals_t items[maxDepth];
+
+  /// @brief
+  static std::map<String, ListCallback> lists;
+
+  /// @brief
+  static std::vector<File> partials;
+
+  /// @brief
+  static void addLiteral(Template &tpl, const char *from, const char *to) {
+    if (to > from)
+      tpl.tokens.push_back({Literal, -1,
+                            static_cast<uint32_t>(from - tpl.source),
+                            static_cast<uint32_t>(to - from)});
   }
 
   /// @brief
-  static void renderLine(ClientType &client, const char *line, int from,
-                         const int to, locals_t &locals) {
-    while (from < to) {
-      auto index = find(line, "{{", from, to);
-      if (index < 1)
-        break;
+  static int16_t addName(Template &tpl, const char *begin, const char *end) {
+    // surrounding spaces are not part of the name
+    while (begin < end && *begin == ' ')
+      begin++;
+    while (end > begin && end[-1] == ' ')
+      end--;
+
+    String name;
+    name.concat(begin, end - begin);
+
+    int16_t slot = 0;
+    while (slot < static_cast<int16_t>(tpl.names.size()) &&
+           !tpl.names[slot].equals(name))
+      slot++;
+    if (slot == static_cast<int16_t>(tpl.names.size()))
+      tpl.names.push_back(name);
+
+    return slot;
+  }
+
+  /// @brief strstr() within [from, end), File data is not NUL terminated
+  static auto find(const char *from, const char *end, const char *tag,
+                   const size_t length) -> const char * {
+    while (static_cast<size_t>(end - from) >= length) {
+      from = static_cast<const char *>(
+          memchr(from, *tag, end - from - length + 1));
+      if (!from)
+        return nullptr;
+      if (memcmp(from, tag, length) == 0)
+        return from;
+      from++;
+    }
+    return nullptr;
+  }
+
+  /// @brief Splits the template of length bytes in literal spans and tags.
+  /// @return
+  static auto compile(const char *f, const size_t length) -> const Template & {
+    for (auto tpl : templates)
+      if (tpl->source == f)
+        return *tpl;
+
+    LOG_V(F("mustache compile"));
 
-      client.write(line + from, index - from - 1);
+    auto tpl = new Template();
+    tpl->source = f;
 
-      from = index + 1;
+    std::vector<size_t> open_sections;
 
-      index = find(line, "}}", from, to);
-      if (index < 1)
-        return;
+    auto from = f;
+    auto end = f + length;
+    while (true) {
+      auto open = find(from, end, "{{", 2);
+      if (!open) {
+        addLiteral(*tpl, from, end);
+        break;
+      }
+
+      auto triple = (open + 2 < end && open[2] == '{');
+      auto close = triple ? find(open + 3, end, "}}}", 3)
+                          : find(open + 2, end, "}}", 2);
+      if (!close) {
+        addLiteral(*tpl, from, end);
+        break;
+      }
 
-      char key_[15];
-      strncpy(key_, line + from, index - from - 1);
-      key_[index - from - 1] = '\0';
+      addLiteral(*tpl, from, open);
+      from = close + (triple ? 3 : 2);
 
-      client.print(locals[key_]);
+      auto begin = open + (triple ? 3 : 2);
+      auto sigil = triple ? '{' : *begin;
 
-      from = index + 1;
+      switch (sigil) {
+      case '!':
+        break;
+      case '{':
+        tpl->tokens.push_back({Raw, addName(*tpl, begin, close), 0, 0});
+        break;
+      case '&':
+        tpl->tokens.push_back({Raw, addName(*tpl, begin + 1, close), 0, 0});
+        break;
+      case '>':
+        tpl->tokens.push_back({Partial, addName(*tpl, begin + 1, close), 0, 0});
+        break;
+      case '#':
+      case '^':
+        open_sections.push_back(tpl->tokens.size());
+        tpl->tokens.push_back({(sigil == '#') ? Section : Inverted,
+                               addName(*tpl, begin + 1, close), 0, 0});
+        break;
+      case '/': {
+        auto slot = addName(*tpl, begin + 1, close);
+        if (!open_sections.empty() &&
+            tpl->tokens[open_sections.back()].slot == slot) {
+          tpl->tokens[open_sections.back()].offset = tpl->tokens.size();
+          open_sections.pop_back();
+        } else
+          LOG_W(F("mustache: unexpected closing tag"), tpl->names[slot]);
+        break;
+      }
+      default:
+        tpl->tokens.push_back({Variable, addName(*tpl, begin, close), 0, 0});
+        break;
+      }
     }
 
-    if (from < to) {
-      client.write(line + from, to - from);
-      client.write('\n');
+    // unclosed sections run to the end of the template
+    for (auto index : open_sections)
+      tpl->tokens[index].offset = tpl->tokens.size();
+
+    templates.push_back(tpl);
+
+    return *tpl;
+  }
+
+  /// @brief Item locals first (innermost section first), then view locals.
+  static auto resolve(Scope &scope, const Template &tpl, size_t base,
+                      int16_t slot) -> const String * {
+    for (auto depth = scope.depth; depth-- > 0;) {
+      auto item = items[depth].find(tpl.names[slot]);
+      if (item != items[depth].end())
+        return &item->second;
     }
+    return values[base + slot];
   }
 
-public:
   /// @brief
-  static void renderFile(ClientType &client, locals_t &locals, Options *options, const char *f) {
-    LOG_V(F("> renderFile"));
+  static bool truthy(const String *value) {
+    return value && value->length() > 0 && strcmp(value->c_str(), False) != 0;
+  }
 
-    size_t i = 0;
-    size_t start = 0;
-    while (f[start + i] != '\0') {
-      while (f[start + i] != '\n' && f[start + i] != '\0')
-        i++;
+  /// @brief
+  static auto findPartial(const String &name) -> const File * {
+    for (auto &file : partials) {
+      // with or without extension
+      if (file.filename.startsWith(name) &&
+          (file.filename.length() == name.length() ||
+           file.filename.charAt(name.length()) == '.'))
+        return &file;
+    }
+    return nullptr;
+  }
 
-      renderLine(client, f, start, start + i, locals);
+  /// @brief
+  static void renderTokens(Scope &scope, const Template &tpl, size_t base,
+                           size_t from, size_t to) {
+    auto &client = scope.client;
 
-      if (f[start + i] == '\0')
+    for (auto i = from; i < to; i++) {
+      auto &token = tpl.tokens[i];
+
+      switch (token.type) {
+      case Literal:
+        client.write(tpl.source + token.offset, token.length);
+        break;
+      case Variable:
+        if (auto value = resolve(scope, tpl, base, token.slot))
+          HtmlEscape::write(client, value->c_str(), value->length());
+        break;
+      case Raw:
+        if (auto value = resolve(scope, tpl, base, token.slot))
+          client.write(value->c_str(), value->length());
         break;
+      case Section:
+      case Inverted: {
+        auto list = lists.find(tpl.names[token.slot]);
+        if (list != lists.end() && scope.depth < maxDepth) {
+          auto &item = items[scope.depth];
+          item.clear();
 
-      start += i + 1;
-      i = 0;
+          if (token.type == Section) {
+            scope.depth++;
+            for (size_t n = 0; list->second(n, item); n++)
+              renderTokens(scope, tpl, base, i + 1, token.offset);
+            scope.depth--;
+          } else if (!list->second(0, item))
+            renderTokens(scope, tpl, base, i + 1, token.offset);
+        } else {
+          auto value = resolve(scope, tpl, base, token.slot);
+          if (truthy(value) == (token.type == Section))
+            renderTokens(scope, tpl, base, i + 1, token.offset);
+        }
+
+        i = token.offset - 1; // skip the section
+        break;
+      }
+      case Partial: {
+        auto file = findPartial(tpl.names[token.slot]);
+        if (file && scope.partials < maxDepth) {
+          scope.partials++;
+          renderTemplate(scope,
+                         compile(reinterpret_cast<const char *>(file->data()),
+                                 file->length()));
+          scope.partials--;
+        } else if (!file)
+          LOG_W(F("mustache: partial not found"), tpl.names[token.slot]);
+        break;
+      }
+      }
     }
+  }
+
+  /// @brief
+  static void renderTemplate(Scope &scope, const Template &tpl) {
+    // one lookup per distinct name, missing locals render empty
+    auto base = values.size();
+    values.resize(base + tpl.names.size());
+    for (size_t i = 0; i < tpl.names.size(); i++)
+      values[base + i] = scope.locals.find(tpl.names[i]);
+
+    renderTokens(scope, tpl, base, 0, tpl.tokens.size());
+
+    values.resize(base);
+  }
+
+public:
+  /// @brief Registers the items provider of {{#name}} sections.
+  /// @param name
+  /// @param provider
+  static void list(const String &name, const ListCallback provider) {
+    lists[name] = provider;
+  }
+
+  /// @brief Registers a file that templates can include with {{> name}},
+  /// name being the filename with or without extension.
+  /// @param file
+  static void partial(const File &file) { partials.push_back(file); }
+
+  /// @brief
+  static void renderFile(Print &client, const Locals &locals,
+                         Options *, const char *f,
+                         const size_t length) {
+    LOG_V(F("> renderFile"));
+
+    Scope scope{client, locals, 0, 0};
+    renderTemplate(scope, compile(f, length));
 
     LOG_V(F("< renderFile"));
   }
 };
 
+std::vector<mustache::Template *> mustache::templates{};
+std::vector<const String *> mustache::values{};
+locals_t mustache::items[mustache::maxDepth]{};
+std::map<String, mustache::ListCallback> mustache::lists{};
+std::vector<File> mustache::partials{};
+
 END_EXPRESS_NAMESPACE
 
 /// @brief
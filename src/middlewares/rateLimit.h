@@ -0,0 +1,117 @@
+#include "defs.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief Token bucket rate limiter, one bucket per client IP. A bucket
+/// holds up to burst tokens and gains one every refill milliseconds, each
+/// request takes one. Without tokens the request is answered with 429 Too
+/// Many Requests and a Retry-After header, before anything else (such as a
+/// body parser) runs.
+///
+/// Buckets live in a fixed table of clients entries (a power of 2). A client
+/// is looked up in a window of probe slots from its hash, when it is not there
+/// it takes an empty slot or the slot of the longest idle client in that
+/// window. Evicting a client only resets its bucket.
+///
+/// Each combination of template arguments has its own table: limiters with
+/// the same arguments share their buckets, unless they are given a different
+/// tag (eg one per route).
+template <uint16_t burst, uint32_t refill, uint16_t clients = 32,
+          uint8_t tag = 0>
+class RateLimit {
+  static_assert((clients & (clients - 1)) == 0, "clients must be a power of 2");
+
+private:
+  static const uint16_t probe = (clients < 8) ? clients : 8;
+
+  struct Bucket {
+    uint32_t ip;  // 0: empty
+    uint32_t last; // millis() of the last refill
+    uint16_t tokens;
+  };
+
+  static Bucket buckets_[clients];
+
+  /// @brief
+  static auto hash(const uint32_t ip) -> uint16_t {
+    return AssetIndex::hash(reinterpret_cast<const char *>(&ip), sizeof(ip)) &
+           (clients - 1);
+  }
+
+  /// @brief the bucket of ip, taking over an empty or idle slot for a new
+  /// client
+  static auto find(const uint32_t ip, const uint32_t now) -> Bucket & {
+    auto home = hash(ip);
+
+    Bucket *victim = nullptr;
+    for (uint16_t i = 0; i < probe; i++) {
+      auto &bucket = buckets_[(home + i) & (clients - 1)];
+      if (bucket.ip == ip)
+        return bucket;
+      if (!victim || bucket.ip == 0 ||
+          (victim->ip != 0 && now - bucket.last > now - victim->last))
+        victim = &bucket;
+    }
+
+    victim->ip = ip;
+    victim->last = now;
+    victim->tokens = burst;
+    return *victim;
+  }
+
+public:
+  /// @brief
+  static auto handler(_Request &req, _Response &res, const NextCallback next)
+      -> void {
+    auto now = millis();
+    auto &bucket = find(static_cast<uint32_t>(req.ip), now);
+
+    // refill, keeping the time of a partially earned token
+    auto earned = (now - bucket.last) / refill;
+    if (earned > 0) {
+      bucket.tokens = (bucket.tokens + earned >= burst)
+                          ? burst
+                          : static_cast<uint16_t>(bucket.tokens + earned);
+      bucket.last = (bucket.tokens == burst) ? now : bucket.last + earned * refill;
+    }
+
+    if (bucket.tokens > 0) {
+      bucket.tokens--;
+      next(nullptr);
+      return;
+    }
+
+    // whole seconds until the next token, at least 1
+    auto wait = refill - (now - bucket.last);
+    LOG_V(F("rate limited"), req.ip, wait);
+
+    res.set(F("Retry-After"), String((wait + 999) / 1000));
+    res.status(HttpStatus::TOO_MANY_REQUESTS);
+  }
+
+  /// @brief Forgets all clients
+  static auto reset() -> void { memset(buckets_, 0, sizeof(buckets_)); }
+};
+
+template <uint16_t burst, uint32_t refill, uint16_t clients, uint8_t tag>
+typename RateLimit<burst, refill, clients, tag>::Bucket
+    RateLimit<burst, refill, clients, tag>::buckets_[clients] = {};
+
+END_EXPRESS_NAMESPACE
+
+/// @brief Rate limiting middleware, for a route or the whole app. Limiters
+/// with the same arguments share their buckets, give each a tag to keep them
+/// apart:
+///
+///     app.post(F("/login"), rateLimit<5, 60000, 32, 1>(), ...);
+///     app.post(F("/reset"), rateLimit<5, 60000, 32, 2>(), ...);
+/// @tparam burst requests a client can make at once
+/// @tparam refill milliseconds it takes to earn one more request
+/// @tparam clients number of clients tracked, a power of 2
+/// @tparam tag tells limiters with the same arguments apart
+/// @return
+template <uint16_t burst, uint32_t refill, uint16_t clients = 32,
+          uint8_t tag = 0>
+static MiddlewareCallback rateLimit() {
+  return RateLimit<burst, refill, clients, tag>::handler;
+}
@@ -0,0 +1,224 @@
+#include "defs.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief Caches complete GET responses (status line, headers and body) in a
+/// byte budget LRU, keyed by method, path, query and the request headers
+/// registered with vary(). A fresh entry is written to the client before any
+/// route handler runs.
+///
+/// Within the stale window after the TTL, the stale entry is sent right away
+/// and the handlers still run, into the cache only, to refresh it. They run
+/// inline, within the same request: the client has the complete (stale)
+/// response, but the connection is only closed once they are done.
+///
+/// When a response passes more than one cache (eg one for the whole app and
+/// one on the route), the first captures it; the others step aside.
+///
+/// Only 200 responses without Set-Cookie and without Cache-Control no-store
+/// or private are stored.
+class ResponseCache {
+private:
+  static RenderCache store_;
+  static std::vector<String> vary_;
+
+  /// @brief a response being captured, from handler() to its finish callback
+  struct Capture {
+    const _Response *res = nullptr;
+    RenderCapture bytes{0};
+    uint64_t key = 0;
+    uint32_t tag = 0;
+  };
+
+  static const size_t maxCaptures = 2; // responses captured at the same time
+  static Capture captures_[maxCaptures];
+
+  /// @brief
+  /// @return the capture of res, nullptr when there is none
+  static auto captureOf(const _Response *res) -> Capture * {
+    for (auto &capture : captures_)
+      if (capture.res == res)
+        return &capture;
+    return nullptr;
+  }
+
+  /// @brief
+  static auto release(Capture &capture) -> void {
+    capture.res = nullptr;
+    capture.bytes.reset(0);
+    capture.bytes.bytes.shrink_to_fit();
+  }
+
+  /// @brief
+  static auto key(_Request &req) -> uint64_t {
+    auto h = RenderCache::hash(req.method.c_str(), req.method.length() + 1);
+    h = RenderCache::hash(req.uri.c_str(), req.uri.length() + 1, h);
+    for (auto &[name, value] : req.query) {
+      h = RenderCache::hash(name.c_str(), name.length() + 1, h);
+      h = RenderCache::hash(value.c_str(), value.length() + 1, h);
+    }
+    for (auto &field : vary_) {
+      auto value = req.get(field);
+      h = RenderCache::hash(value.c_str(), value.length() + 1, h);
+    }
+    return h;
+  }
+
+  /// @brief
+  static auto tag(const String &path) -> uint32_t {
+    return AssetIndex::hash(path.c_str(), path.length());
+  }
+
+  /// @brief
+  /// @return true when the captured head has a Set-Cookie header
+  static auto setsCookie(const std::vector<uint8_t> &bytes) -> bool {
+    static const char field[] = "\r\nSet-Cookie:";
+    const size_t length = sizeof(field) - 1;
+
+    for (size_t i = 0; i + length <= bytes.size(); i++) {
+      if (bytes[i] == '\r' && i + 3 < bytes.size() && bytes[i + 2] == '\r')
+        return false; // end of the headers
+      if (memcmp(bytes.data() + i, field, length) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  /// @brief finish callback, stores the captured response
+  static auto store(_Request &, _Response &res) -> void {
+    auto capture = captureOf(&res);
+    if (!capture)
+      return;
+
+    if (!capture->bytes.overflow && res.status_ == HttpStatus::OK &&
+        cacheable(res) && !setsCookie(capture->bytes.bytes)) {
+      LOG_V(F("response cached"), res.req.uri, capture->bytes.bytes.size());
+      store_.put(capture->key, std::move(capture->bytes.bytes), capture->tag);
+    }
+
+    release(*capture);
+  }
+
+  /// @brief
+  /// @return false when Cache-Control forbids storing the response
+  static auto cacheable(_Response &res) -> bool {
+    auto cacheControl = res.get(F("Cache-Control"));
+    return cacheControl.indexOf(F("no-store")) < 0 &&
+           cacheControl.indexOf(F("private")) < 0;
+  }
+
+  /// @brief sends entry through the response, so that its status and bytes
+  /// are seen by the finish callbacks (eg an access log) and the metrics
+  static auto replay(_Response &res, const RenderCache::Entry &entry)
+      -> void {
+    auto &bytes = entry.bytes;
+
+    // the headers end at the first empty line
+    size_t headerLength = bytes.size();
+    for (size_t i = 0; i + 4 <= bytes.size(); i++)
+      if (memcmp(bytes.data() + i, "\r\n\r\n", 4) == 0) {
+        headerLength = i + 4;
+        break;
+      }
+
+    // only 200 responses are stored
+    res.replay(HttpStatus::OK, bytes.data(), bytes.size(), headerLength);
+  }
+
+public:
+  /// @brief
+  /// @tparam ttl milliseconds an entry is fresh
+  /// @tparam stale milliseconds after ttl a stale entry is served while the
+  /// handlers refresh it
+  template <uint32_t ttl, uint32_t stale>
+  static auto handler(_Request &req, _Response &res, const NextCallback next)
+      -> void {
+    if (store_.capacity() == 0 || !req.method.equals(F("GET"))) {
+      next(nullptr);
+      return;
+    }
+
+    // another cache captures this response already
+    if (captureOf(&res)) {
+      next(nullptr);
+      return;
+    }
+
+    auto key = ResponseCache::key(req);
+
+    auto muted = false;
+    if (auto entry = store_.get(key)) {
+      auto age = millis() - entry->stored;
+
+      if (age < ttl) {
+        LOG_V(F("response cache hit"), req.uri);
+        replay(res, *entry);
+        res.headersSent = true;
+        return;
+      }
+
+      if (age < ttl + stale) {
+        // the client gets the stale copy now, the handlers refresh it
+        LOG_V(F("response cache stale"), req.uri);
+        replay(res, *entry);
+        muted = true;
+      } else
+        store_.remove(key);
+    }
+
+    auto capture = captureOf(nullptr);
+    if (!capture || !res.onFinish(store)) {
+      LOG_W(F("responseCache: response not captured"), req.uri);
+      if (muted)
+        res.capture(nullptr, true); // the client has the stale copy
+      next(nullptr);
+      return;
+    }
+
+    capture->res = &res;
+    capture->key = key;
+    capture->tag = tag(req.uri);
+    capture->bytes.reset(store_.capacity());
+    res.capture(&capture->bytes, muted);
+
+    next(nullptr);
+  }
+
+  /// @brief Sets the cache size in bytes, 0 disables (and empties) it.
+  static auto capacity(const size_t bytes) -> void { store_.capacity(bytes); }
+
+  /// @brief
+  /// @return bytes in use
+  static auto size() -> size_t { return store_.size(); }
+
+  /// @brief Makes the value of a request header part of the key, eg
+  /// "accept-encoding" when a handler responds differently per encoding.
+  static auto vary(const String &field) -> void { vary_.push_back(field); }
+
+  /// @brief Removes the cached responses for path, for any query and header
+  /// variation.
+  /// @return the number of entries removed
+  static auto invalidate(const String &path) -> size_t {
+    return store_.removeTag(tag(path == F("/") ? String() : path));
+  }
+
+  /// @brief Removes all cached responses.
+  static auto clear() -> void { store_.clear(); }
+};
+
+RenderCache ResponseCache::store_{};
+std::vector<String> ResponseCache::vary_{};
+ResponseCache::Capture ResponseCache::captures_[ResponseCache::maxCaptures]{};
+
+END_EXPRESS_NAMESPACE
+
+/// @brief Response cache middleware, for a route or the whole app. Set the
+/// cache size with ResponseCache::capacity() first.
+/// @tparam ttl milliseconds a response is served from the cache
+/// @tparam stale milliseconds after ttl a stale response is still served, while
+/// the handlers run to refresh it
+/// @return
+template <uint32_t ttl, uint32_t stale = 0>
+static MiddlewareCallback responseCache() {
+  return ResponseCache::handler<ttl, stale>;
+}
@@ -0,0 +1,333 @@
+#include "defs.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief
+class SessionOptions {
+public:
+  /// Name of the session ID cookie.
+  String name = F("sid");
+  /// Maximum number of sessions kept, the least recently used session is
+  /// evicted to make room for a new one.
+  uint16_t maxSessions = 16;
+  /// Bytes of key/value storage per session. Each entry takes 3 bytes plus
+  /// the length of its key and value.
+  uint16_t sessionSize = 128;
+  /// Sessions idle for longer than this (in milliseconds) expire, 0: never.
+  uint32_t maxAge = 30 * 60 * 1000;
+  /// Attributes of the session ID cookie. It is signed when the app has a
+  /// "cookie secret" setting, regardless of cookie.sign.
+  CookieOptions cookie{};
+
+  SessionOptions() { cookie.httpOnly = true; }
+};
+
+/// @brief The session of a request (req.session). Keys and values are
+/// stored back to back in a fixed size arena owned by the session store.
+class Session {
+  friend class SessionStore;
+
+private:
+  static const size_t idLength = 32;
+
+  char id_[idLength + 1];
+  uint32_t hash_;
+  uint32_t lastAccess_;
+  bool inUse_;
+
+  uint8_t *arena_;
+  uint16_t capacity_;
+  uint16_t used_;
+
+  /// @brief
+  /// @return offset of the entry of key in the arena, or -1
+  auto find(const char *key, const size_t keyLength) const -> int {
+    size_t offset = 0;
+    while (offset < used_) {
+      auto entryKeyLength = arena_[offset];
+      if (entryKeyLength == keyLength &&
+          memcmp(arena_ + offset + 3, key, keyLength) == 0)
+        return offset;
+      offset += entrySize(offset);
+    }
+    return -1;
+  }
+
+  /// @brief
+  auto entrySize(const size_t offset) const -> size_t {
+    return 3 + arena_[offset] + (arena_[offset + 1] | arena_[offset + 2] << 8);
+  }
+
+public:
+  /// @brief
+  /// @return the session ID
+  auto id() const -> const char * { return id_; }
+
+  /// @brief
+  /// @return the value of key, empty when not set
+  auto get(const String &key) const -> String {
+    auto offset = find(key.c_str(), key.length());
+    if (offset < 0)
+      return F("");
+
+    auto valueLength = arena_[offset + 1] | arena_[offset + 2] << 8;
+    String value;
+    value.concat(reinterpret_cast<const char *>(arena_ + offset + 3 +
+                                                key.length()),
+                 valueLength);
+    return value;
+  }
+
+  /// @brief
+  auto has(const String &key) const -> bool {
+    return find(key.c_str(), key.length()) >= 0;
+  }
+
+  /// @brief Sets key to value.
+  /// @return false when the session has no room left (or keys longer than
+  /// 255 bytes), the previous value is kept then.
+  auto set(const String &key, const String &value) -> bool {
+    if (!inUse_ || key.length() > 255)
+      return false;
+
+    auto offset = find(key.c_str(), key.length());
+    auto freed = (offset >= 0) ? entrySize(offset) : 0;
+
+    auto size = 3 + key.length() + value.length();
+    if (used_ - freed + size > capacity_)
+      return false;
+
+    if (offset >= 0)
+      remove(offset);
+
+    auto entry = arena_ + used_;
+    entry[0] = key.length();
+    entry[1] = value.length() & 0xff;
+    entry[2] = value.length() >> 8;
+    memcpy(entry + 3, key.c_str(), key.length());
+    memcpy(entry + 3 + key.length(), value.c_str(), value.length());
+    used_ += size;
+
+    return true;
+  }
+
+  /// @brief Removes key from the session.
+  auto remove(const String &key) -> void {
+    auto offset = find(key.c_str(), key.length());
+    if (offset >= 0)
+      remove(offset);
+  }
+
+  /// @brief Removes all keys.
+  auto clear() -> void { used_ = 0; }
+
+  /// @brief
+  /// @return bytes in use by keys and values
+  auto size() const -> size_t { return used_; }
+
+  /// @brief Destroys the session, its ID is no longer valid. Use
+  /// res.clearCookie() to remove the cookie from the client.
+  auto destroy() -> void;
+
+private:
+  /// @brief
+  auto remove(const size_t offset) -> void {
+    auto size = entrySize(offset);
+    memmove(arena_ + offset, arena_ + offset + size, used_ - offset - size);
+    used_ -= size;
+  }
+};
+
+/// @brief In-process session store. All memory is allocated once, when the
+/// middleware is created: maxSessions * (sizeof(Session) + sessionSize) plus
+/// a small lookup table. Sessions are found by ID in an open addressing table
+/// (linear probing), expire after maxAge of inactivity and the least recently
+/// used session makes room when the store is full.
+class SessionStore {
+  friend class Session;
+
+private:
+  static SessionOptions options_;
+  static std::vector<Session> sessions_;
+  static std::vector<uint8_t> arena_;
+  static std::vector<uint16_t> table_; // session index + 1, 0 = empty
+  static uint16_t mask_;
+
+  /// @brief
+  static auto hash(const char *id) -> uint32_t {
+    return AssetIndex::hash(id, Session::idLength);
+  }
+
+  /// @brief
+  /// @return the table slot of the session with id, or -1
+  static auto findSlot(const char *id) -> int {
+    auto h = hash(id);
+    for (auto slot = h & mask_;; slot = (slot + 1) & mask_) {
+      auto entry = table_[slot];
+      if (entry == 0)
+        return -1;
+
+      auto &session = sessions_[entry - 1];
+      if (session.hash_ == h && memcmp(session.id_, id, Session::idLength) == 0)
+        return slot;
+    }
+  }
+
+  /// @brief Removes a session, shifting back later entries of the probe
+  /// chain so no tombstones are needed.
+  static auto release(Session &session) -> void {
+    session.inUse_ = false;
+    session.used_ = 0;
+
+    auto slot = findSlot(session.id_);
+    if (slot < 0)
+      return;
+
+    table_[slot] = 0;
+    for (auto next = (slot + 1) & mask_; table_[next] != 0;
+         next = (next + 1) & mask_) {
+      auto home = sessions_[table_[next] - 1].hash_ & mask_;
+      // move the entry to the hole when the hole lies on its probe path
+      auto distanceHole = (slot - home) & mask_;
+      auto distanceNext = (next - home) & mask_;
+      if (distanceHole < distanceNext) {
+        table_[slot] = table_[next];
+        table_[next] = 0;
+        slot = next;
+      }
+    }
+  }
+
+  /// @brief
+  static auto expired(const Session &session, const uint32_t now) -> bool {
+    return options_.maxAge > 0 && now - session.lastAccess_ > options_.maxAge;
+  }
+
+  /// @brief a free session, evicting the least recently used when full
+  static auto allocate(const uint32_t now) -> Session & {
+    Session *oldest = nullptr;
+    for (auto &session : sessions_) {
+      if (!session.inUse_)
+        return session;
+      if (!oldest || now - session.lastAccess_ > now - oldest->lastAccess_)
+        oldest = &session;
+    }
+
+    LOG_V(F("session evicted"), oldest->id_);
+    release(*oldest);
+    return *oldest;
+  }
+
+  /// @brief
+  static auto create(const uint32_t now) -> Session & {
+    auto &session = allocate(now);
+
+    static const char hex[] = "0123456789abcdef";
+    do {
+      for (size_t i = 0; i < Session::idLength; i += 8) {
+        auto r = esp_random();
+        for (size_t j = 0; j < 8; j++, r >>= 4)
+          session.id_[i + j] = hex[r & 15];
+      }
+      session.id_[Session::idLength] = '\0';
+    } while (findSlot(session.id_) >= 0);
+
+    session.hash_ = hash(session.id_);
+    session.inUse_ = true;
+    session.used_ = 0;
+
+    auto index = &session - sessions_.data();
+    auto slot = session.hash_ & mask_;
+    while (table_[slot] != 0)
+      slot = (slot + 1) & mask_;
+    table_[slot] = index + 1;
+
+    return session;
+  }
+
+public:
+  /// @brief
+  /// @param options
+  static auto init(const SessionOptions &options) -> void {
+    options_ = options;
+
+    // at least twice the number of sessions, so probe chains stay short
+    uint16_t size = 4;
+    while (size < options.maxSessions * 2)
+      size <<= 1;
+    mask_ = size - 1;
+    table_.assign(size, 0);
+
+    arena_.assign(options.maxSessions * options.sessionSize, 0);
+    sessions_.assign(options.maxSessions, Session());
+    for (size_t i = 0; i < sessions_.size(); i++) {
+      sessions_[i].inUse_ = false;
+      sessions_[i].used_ = 0;
+      sessions_[i].arena_ = arena_.data() + i * options.sessionSize;
+      sessions_[i].capacity_ = options.sessionSize;
+    }
+  }
+
+  /// @brief
+  /// @return the number of live sessions
+  static auto size() -> size_t {
+    size_t count = 0;
+    for (auto &session : sessions_)
+      count += session.inUse_;
+    return count;
+  }
+
+  /// @brief
+  static auto handler(_Request &req, _Response &res, const NextCallback next)
+      -> void {
+    auto now = millis();
+    auto sign = req.app.settings.count(F("cookie secret")) > 0;
+
+    auto id = sign ? req.cookies.getSigned(options_.name)
+                   : req.cookies.get(options_.name);
+
+    Session *session = nullptr;
+    if (id.length() == Session::idLength) {
+      auto slot = findSlot(id.c_str());
+      if (slot >= 0) {
+        session = &sessions_[table_[slot] - 1];
+        if (expired(*session, now)) {
+          LOG_V(F("session expired"), session->id_);
+          release(*session);
+          session = nullptr;
+        }
+      }
+    }
+
+    if (!session) {
+      session = &create(now);
+
+      CookieOptions cookie(options_.cookie);
+      cookie.sign = sign;
+      res.cookie(options_.name, session->id_, cookie);
+    }
+
+    session->lastAccess_ = now;
+    req.session = session;
+
+    next(nullptr);
+  }
+};
+
+SessionOptions SessionStore::options_{};
+std::vector<Session> SessionStore::sessions_{};
+std::vector<uint8_t> SessionStore::arena_{};
+std::vector<uint16_t> SessionStore::table_{};
+uint16_t SessionStore::mask_ = 0;
+
+inline auto Session::destroy() -> void { SessionStore::release(*this); }
+
+END_EXPRESS_NAMESPACE
+
+/// @brief Session middleware, see SessionOptions. The session ID cookie is
+/// signed when the app has a "cookie secret" setting.
+/// @return
+static MiddlewareCallback session(const SessionOptions &options = SessionOptions()) {
+  SessionStore::init(options);
+  return SessionStore::handler;
+}
@@ -23,6 +23,7 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define LOG_MODULE LOG_MODULE_REQUEST
 #include "Express.h"
 
 BEGIN_EXPRESS_NAMESPACE
@@ -35,20 +36,103 @@ _Request::_Request(_Express &express, ClientType &ec)
 
 /// @brief Checks if the specified content types are acceptable, based on the
 /// request’s Accept HTTP header field. The method returns the best match, or if
-/// none of the specified content types is acceptable, returns false (in which
-/// case, the application should respond with 406 "Not Acceptable").
-auto _Request::accepts(const String &types) -> bool { return false; }
+/// none of the specified content types is acceptable, returns an empty string
+/// (in which case, the application should respond with 406 "Not Acceptable").
+auto _Request::accepts(const String &types) -> String {
+  auto accept = header(F("accept"));
+
+  const char *best = nullptr;
+  const char *bestEnd = nullptr;
+  int bestQuality = 0;
+
+  MediaType::forEach(types.c_str(), [&](const char *item, const char *end) {
+    auto type = item;
+    auto typeEnd = end;
+    if (!MediaType::resolve(type, typeEnd))
+      return true;
+
+    // without an Accept header, everything is acceptable: the first wins
+    auto quality = accept ? MediaType::quality(accept->c_str(), type, typeEnd)
+                          : 1000;
+    if (quality > bestQuality) {
+      bestQuality = quality;
+      best = item;
+      bestEnd = end;
+    }
+    return bestQuality < 1000;
+  });
+
+  if (!best)
+    return F("");
+
+  String result;
+  result.concat(best, bestEnd - best);
+  return result;
+}
+
+/// @brief
+/// @param type
+/// @return
+auto _Request::acceptQuality(const char *type) const -> int {
+  auto typeEnd = type + strlen(type);
+  if (!MediaType::resolve(type, typeEnd))
+    return 0;
+
+  auto accept = header(F("accept"));
+  if (!accept)
+    return 1000;
+
+  return MediaType::quality(accept->c_str(), type, typeEnd);
+}
 
 /// @brief Returns the matching content type if the incoming request’s
 /// “Content-Type” HTTP header field matches the MIME type specified by the
-/// type parameter. If the request has no body, returns null. Returns false
-/// otherwise.
-auto _Request::is(const String &types) -> String { return F(""); }
+/// type parameter. If the request has no body, or nothing matches, returns an
+/// empty string.
+auto _Request::is(const String &types) -> String {
+  auto contentType = header(F("content-type"));
+  if (!contentType)
+    return F("");
+
+  // no body, nothing to match
+  auto contentLength = header(F("content-length"));
+  if (!header(F("transfer-encoding")) &&
+      (!contentLength || contentLength->toInt() == 0))
+    return F("");
+
+  // the media type, without parameters (; charset=utf-8)
+  auto media = contentType->c_str();
+  auto mediaEnd = media;
+  while (*mediaEnd && *mediaEnd != ';' && *mediaEnd != ' ')
+    mediaEnd++;
+
+  const char *match = nullptr;
+  const char *matchEnd = nullptr;
+
+  MediaType::forEach(types.c_str(), [&](const char *item, const char *end) {
+    auto type = item;
+    auto typeEnd = end;
+    if (!MediaType::resolve(type, typeEnd) ||
+        MediaType::match(type, typeEnd, media, mediaEnd) < 0)
+      return true;
+
+    match = item;
+    matchEnd = end;
+    return false;
+  });
+
+  if (!match)
+    return F("");
+
+  String result;
+  result.concat(match, matchEnd - match);
+  return result;
+}
 
 /// @brief Range header parser.
 /// The size parameter is the maximum size of the resource.
 /// The options parameter is an object that can have the following properties.
-auto _Request::range(const size_t &size) -> const Range & {
+auto _Request::range(const size_t &size) -> Range {
   return _Request::rangeParse(get(F("range")), size);
 };
 
@@ -57,15 +141,25 @@ auto _Request::range(const size_t &size) -> const Range & {
 /// @param field
 /// @return
 auto _Request::get(const String &field) -> String {
-  for (auto [key, header] : headers) {
-    if (field.equalsIgnoreCase(key))
-      return header;
-  }
+  if (auto value = header(field))
+    return *value;
 
   static String empty{};
   return empty;
 }
 
+/// @brief
+/// @param field
+/// @return
+auto _Request::header(const String &field) const -> const String * {
+  for (auto &[key, value] : headers) {
+    if (field.equalsIgnoreCase(key))
+      return &value;
+  }
+
+  return nullptr;
+}
+
 /// @brief
 /// @param client
 /// @return
@@ -75,6 +169,7 @@ bool _Request::parse(ClientType &client) {
   // Read the first line of HTTP request
   String reqStr = client.readStringUntil('\r');
   client.readStringUntil('\n');
+  headerLength_ = reqStr.length() + 2;
 
   LOG_V(F("First line"), reqStr);
 
@@ -134,6 +229,7 @@ bool _Request::parse(ClientType &client) {
   while (true) {
     reqStr = client.readStringUntil('\r');
     client.readStringUntil('\n');
+    headerLength_ += reqStr.length() + 2;
 
     if (reqStr == "")
       break; // no more headers
@@ -149,6 +245,11 @@ bool _Request::parse(ClientType &client) {
     headers[header_name] = header_value; // TODO keep all headers or just a few?
   }
 
+  // parsed on first use
+  auto secret = app.settings.find(F("cookie secret"));
+  cookies.bind(header(F("cookie")),
+               (secret != app.settings.end()) ? &secret->second : nullptr);
+
   // always present
   host = headers[F("host")];
 
@@ -23,6 +23,7 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define LOG_MODULE LOG_MODULE_RESPONSE
 #include "Express.h"
 
 BEGIN_EXPRESS_NAMESPACE
@@ -31,38 +32,45 @@ BEGIN_EXPRESS_NAMESPACE
 /// @param app
 /// @param client
 /// @return
-_Response::_Response(_Express &_Express, ClientType &client)
-    : app(_Express), client_(client) {
+_Response::_Response(_Express &_Express, ClientType &client, _Request &req)
+    : app(_Express), req(req), client_(client), out_(client) {
   headersSent = false;
   LOG_T(F("_Response constructor"));
 }
 
 /// @brief  // default renderer. Send content in chuncks for x bytes
 /// @param client
-/// @param f
-void _Response::renderFile(ClientType &client, Options *options, const char *f,
+/// @param data
+/// @param length
+void _Response::renderFile(Print &client, Options *options,
+                           const uint8_t *data, const size_t length,
                            const Write_Callback callback) {
-  LOG_V(F("default renderer"), (options) ? F("with options.") : F(""));
+  LOG_V(F("default renderer"), (options) ? "with options." : "");
 
   const size_t maxChunkLen = 2048;
 
-  if (options && options->headers.count(F("range")) > 0) {
-
-    LOG_V(F("range renderFile"));
+  Range range;
+  if (options && options->headers.count(F("range")) > 0)
+    range = _Request::rangeParse(options->headers[F("range")], length);
 
-    auto range = _Request::rangeParse(options->headers[F("range")]);
+  if (!range.ranges.empty()) {
 
-    auto fileSize = strlen(f);
+    LOG_V(F("range renderFile"));
 
     for (auto [start, end] : range.ranges) {
+      if (start < 0 || static_cast<size_t>(start) >= length)
+        continue;
+
+      // end is inclusive
       size_t i = start;
-      while (i < end) {
+      size_t last = (static_cast<size_t>(end) < length) ? end : length - 1;
+      while (i <= last) {
         auto remaining =
-            (i + maxChunkLen <= end) ? maxChunkLen : end - i + 1; // size
+            (last - i + 1 > maxChunkLen) ? maxChunkLen : last - i + 1; // size
         //      LOG_V("write", i, remaining);
         if (callback)
-          callback(f + i, remaining);
-        client.write(f + i, remaining);
+          callback(reinterpret_cast<const char *>(data + i), remaining);
+        client.write(data + i, remaining);
         i += remaining;
       }
     }
@@ -70,16 +78,15 @@ void _Response::renderFile(ClientType &client, Options *options, const char *f,
   }
 
   size_t i = 0;
-  size_t end = strlen(f);
 
-  LOG_V(F("vanilla renderFile"), i, end);
+  LOG_V(F("vanilla renderFile"), i, length);
 
-  while (i < end) {
+  while (i < length) {
     auto remaining =
-        (i + maxChunkLen <= end) ? maxChunkLen : end - i + 1; // size
+        (length - i > maxChunkLen) ? maxChunkLen : length - i; // size
     if (callback)
-      callback(f + i, remaining);
-    client.write(f + i, remaining);
+      callback(reinterpret_cast<const char *>(data + i), remaining);
+    client.write(data + i, remaining);
     i += remaining;
   }
 }
@@ -90,7 +97,7 @@ void _Response::renderFile(ClientType &client, Options *options, const char *f,
 /// @return
 auto _Response::append(const String &field, const String &value)
     -> _Response & {
-  for (auto [key, header] : headers) {
+  for (auto &[key, header] : headers) {
     if (field.equalsIgnoreCase(key)) {
       // Appends the specified value to the HTTP response header
       header += value;
@@ -106,29 +113,128 @@ auto _Response::append(const String &field, const String &value)
 
 /// @brief
 /// @return
-auto _Response::format() -> void{
-    // TODO
+auto _Response::format(const Format *formats, const size_t count) -> void {
+  vary(F("Accept"));
+
+  const Format *best = nullptr;
+  const Format *fallback = nullptr;
+  int bestQuality = 0;
+
+  for (size_t i = 0; i < count && bestQuality < 1000; i++) {
+    if (!formats[i].type) {
+      fallback = &formats[i];
+      continue;
+    }
+
+    auto quality = req.acceptQuality(formats[i].type);
+    if (quality > bestQuality) {
+      bestQuality = quality;
+      best = &formats[i];
+    }
+  }
+
+  if (best) {
+    auto type = best->type;
+    auto typeEnd = type + strlen(type);
+    MediaType::resolve(type, typeEnd);
+
+    String contentType;
+    contentType.concat(type, typeEnd - type);
+    set(F("Content-Type"), contentType);
+
+    best->callback(req, *this);
+    return;
+  }
+
+  if (fallback) {
+    fallback->callback(req, *this);
+    return;
+  }
+
+  status(HttpStatus::NONE_ACCEPTABLE);
 };
 
+/// @brief
+/// @param field
+/// @return
+auto _Response::vary(const String &field) -> _Response & {
+  for (auto &[key, header] : headers) {
+    if (!key.equalsIgnoreCase(F("Vary")))
+      continue;
+
+    // already listed
+    auto found = false;
+    MediaType::forEach(header.c_str(), [&](const char *item, const char *end) {
+      found = (end - item == (int)field.length()) &&
+              strncasecmp(item, field.c_str(), field.length()) == 0;
+      return !found;
+    });
+    if (!found)
+      header += (header.length() > 0) ? String(F(", ")) + field : field;
+
+    return *this;
+  }
+
+  headers[F("Vary")] = field;
+
+  return *this;
+}
+
+/// @brief Copies file for the response to send. The length is taken on file
+/// first, so that it is cached on the caller's File (typically a global used
+/// for every request) and not only on the copy, which is gone after this
+/// request.
+static auto keep(File &copy, const File &file) -> void {
+  file.length();
+  copy = file;
+}
+
 /// @brief
 /// @return
 auto _Response::download(File &file) -> void {
-  contentsCallback = file.contentsCallback;
-  filename = file.filename;
-  headers[F("Content-Disposition")] = F("attachment; filename=cool.html");
+  keep(file_, file);
+  headers[F("Content-Disposition")] =
+      String(F("attachment; filename=")) + file.filename;
 };
 
 /// @brief
+/// @param name
+/// @param value
+/// @param options
 /// @return
-auto _Response::cookie() -> void{
-    // TODO
-};
+auto _Response::cookie(const String &name, const String &value,
+                       const CookieOptions &options) -> _Response & {
+  if (!options.sign) {
+    cookies_.push_back(Cookies::serialize(name, value, options));
+    return *this;
+  }
+
+  auto secret = app.settings.find(F("cookie secret"));
+  if (secret == app.settings.end() || secret->second.length() == 0) {
+    LOG_E(F("cookie secret is required for signed cookies"));
+    return *this;
+  }
+
+  cookies_.push_back(
+      Cookies::serialize(name, Cookies::sign(value, secret->second), options));
+  return *this;
+}
 
 /// @brief
+/// @param name
+/// @param options
 /// @return
-auto _Response::clearCookie(const String &name) -> void{
-    // TODO
-};
+auto _Response::clearCookie(const String &name, const CookieOptions &options)
+    -> _Response & {
+  CookieOptions expired(options);
+  expired.maxAge = -1;
+
+  auto cookie = Cookies::serialize(name, F(""), expired);
+  cookie += F("; Expires=Thu, 01 Jan 1970 00:00:00 GMT");
+  cookies_.push_back(cookie);
+
+  return *this;
+}
 
 /// @brief Ends the response process. This method actually comes from Node core,
 /// specifically the response.end() method of http.ServerResponse.
@@ -136,11 +242,22 @@ auto _Response::clearCookie(const String &name) -> void{
 /// @param encoding
 /// @return
 auto _Response::end(Buffer *buffer, const String &encoding) -> _Response & {
-  if (buffer) {
-    body_ = buffer->toString();
+  if (buffer)
+    end(buffer->buffer + buffer->byteOffset, buffer->length);
 
-    LOG_V(body_);
-  }
+  return *this;
+}
+
+/// @brief Ends the response process with a binary body.
+/// @param data
+/// @param length
+/// @return
+auto _Response::end(const uint8_t *data, const size_t length) -> _Response & {
+  bodyData_ = data;
+  bodyLength_ = length;
+  set(ContentLength, String(length));
+
+  LOG_V(F("end, binary body of"), length);
 
   return *this;
 }
@@ -186,60 +303,76 @@ auto _Response::send(const String &body) -> _Response & {
 ///      internally.
 /// @param file
 /// @param locals
-auto _Response::render(File &file, locals_t &locals) -> void {
+auto _Response::render(File &file, const locals_t &locals) -> void {
   // NOTE: don't render here just yet (status and headers need to be send first)
   // so store a backpointer that can be called in the sendBody function.
   // set this here already, so it gets send out as part of the headers
 
-  contentsCallback = file.contentsCallback;
-  renderLocals = locals; // TODO: check if this copies??
-  filename = file.filename;
+  // locals usually lives on the stack of the route handler, gone by the time
+  // the view is rendered
+  renderLocals = locals;
+
+  render(file);
+}
+
+/// @brief Renders a view, taking locals over.
+/// @param file
+/// @param locals
+auto _Response::render(File &file, locals_t &&locals) -> void {
+  renderLocals = std::move(locals);
+
+  render(file);
+}
+
+/// @brief Renders a view with res.locals and app.locals.
+/// @param file
+auto _Response::render(File &file) -> void {
+  keep(file_, file);
 
   set(ContentType, F("text/html"));
 }
 
 /// @brief .
 auto _Response::sendFile(const File &file, Options *options) -> void {
-  this->contentsCallback = file.contentsCallback;
-  this->filename = file.filename;
+  keep(this->file_, file);
   if (options)
     this->options = new Options(options);
 
-  if (contentsCallback && options &&
-      options->headers.count(F("range")) > 0) {
-    auto rangeHeader = options->headers[F("range")];
-    auto fileSize = strlen(contentsCallback());
-    auto range = _Request::rangeParse(rangeHeader);
-    size_t sum = 0;
+  auto fileSize = file_.length();
 
-    std::vector<beginEnd> ranges{};
-
-    for (auto [start, end] : range.ranges) {
-      auto cont = (end > fileSize);
-      // check if last range.end is larger than the filesize
-      end = (end > fileSize) ? fileSize - 1 : end;
-      sum += (end - start + 1);
-      ranges.push_back({start, end});
-      if (cont)
-        break;
-    }
+  Range range;
+  if (file_ && options && options->headers.count(F("range")) > 0)
+    range = _Request::rangeParse(options->headers[F("range")], fileSize);
 
-    range.ranges = ranges;
+  if (range.type == F("bytes") && range.ranges.empty()) {
+    // none of the ranges is in the file
+    file_ = File();
+    this->options->headers.erase(F("range"));
+    this->set(F("Content-Range"), String(F("bytes */")) + fileSize);
+    this->set(F("Content-Length"), F("0"));
+    this->status(HttpStatus::RANGE_NOT_SATISFIABLE);
+  } else if (range.type == F("bytes") && range.ranges.size() == 1) {
+    size_t first = range.ranges[0].start;
+    size_t last = range.ranges[0].end;
 
     this->options->headers[F("range")] = range.toString();
 
-    this->set(F("Content-Range"), range.toString() + F("/") + fileSize);
-    this->set(F("Content-Length"), String(sum));
+    this->set(F("Content-Range"), String(F("bytes ")) + first + F("-") + last +
+                                      F("/") + fileSize);
+    this->set(F("Content-Length"), String(last - first + 1));
     this->set(F("Accept-Ranges"), F("bytes"));
     this->status(HttpStatus::PARTIAL_CONTENT);
 
     LOG_V(F("sendFile options"), this->options->acceptRanges,
           this->options->headers[F("range")]);
-  } else if (contentsCallback && options) {
-    for (auto [key, header] : options->headers) {
+  } else if (file_ && options) {
+    // no range, several ranges (no multipart/byteranges) or a malformed
+    // header: the whole file
+    this->options->headers.erase(F("range"));
+    for (auto [key, header] : this->options->headers) {
       this->set(key, header);
     }
-    this->set(F("Content-Length"), String(strlen(contentsCallback())) );
+    this->set(F("Content-Length"), String(fileSize));
   }
 }
 
@@ -256,7 +389,7 @@ auto _Response::sendStatus(const HttpStatus statusCode) -> void {
 /// @param value
 /// @return
 auto _Response::set(const String &field, const String &value) -> _Response & {
-  for (auto [key, header] : headers) {
+  for (auto &[key, header] : headers) {
     if (field.equalsIgnoreCase(key)) {
       // Appends the specified value to the HTTP response header
       header = value;
@@ -293,28 +426,32 @@ void _Response::evaluateHeaders(ClientType &client) {
 
 /// @brief
 /// @param client
-void _Response::sendBody(ClientType &client, locals_t &locals) {
+void _Response::sendBody(Print &client, const Locals &locals) {
   LOG_V(F("sendBody"));
 
   // if we already have a body, send that over
   if (body_ && body_ != F(""))
-    client.println(body_.c_str());
-  else if (contentsCallback) {
+    client.print(body_.c_str());
+  else if (bodyData_) {
+    // bytes are sent straight from where they live (eg flash)
+    renderFile(client, nullptr, bodyData_, bodyLength_, nullptr);
+  } else if (file_) {
     // a request to generate the body was issued earlier,
     // execute it here.
-    int lastDot = filename.lastIndexOf('.');
-    auto ext = filename.substring(lastDot + 1);
-
-    LOG_V(F("file extension:"), ext);
-
-    auto engineName = app.settings[F("view engine")];
-    if (engineName.equals(ext)) {
-      auto engine = app.engines[engineName];
-      if (engine)
-        engine(client, locals, options, contentsCallback());
+    if (auto engine = viewEngine()) {
+      auto f = reinterpret_cast<const char *>(file_.data());
+      if (app.viewCache.capacity() > 0) {
+        // keep a copy of the output for the next request with the same
+        // template and locals
+        RenderCapture capture(client, app.viewCache.capacity());
+        engine(capture, locals, options, f, file_.length());
+        if (!capture.overflow)
+          app.viewCache.put(viewFingerprint_, std::move(capture.bytes));
+      } else
+        engine(client, locals, options, f, file_.length());
     } else {
       LOG_V(F("using default renderer"));
-      renderFile(client, options, contentsCallback(),
+      renderFile(client, options, file_.data(), file_.length(),
                  [](const char *buffer, const uint &len) {
                    LOG_V(F(""));
                  }); // TODO using callback (so not to send client)
@@ -322,31 +459,131 @@ void _Response::sendBody(ClientType &client, locals_t &locals) {
   }
 }
 
+/// @brief
+/// @return the engine registered for the file extension, or nullptr when
+/// the file is not a view (the default renderer is used)
+auto _Response::viewEngine() -> RenderEngineCallback {
+  int lastDot = file_.filename.lastIndexOf('.');
+  auto ext = file_.filename.substring(lastDot + 1);
+
+  LOG_V(F("file extension:"), ext);
+
+  auto engineName = app.settings[F("view engine")];
+  if (!engineName.equals(ext))
+    return nullptr;
+
+  auto engine = app.engines.find(engineName);
+  return (engine != app.engines.end()) ? engine->second : nullptr;
+}
+
 /// @brief
 void _Response::send() {
-  auto &client = const_cast<ClientType &>(client_);
+  auto &client = out_;
+
+  // a middleware wrote the response itself
+  if (headersSent) {
+    out_.flush();
+    finish();
+    return;
+  }
+
+  // render locals over res.locals over app.locals
+  Locals viewLocals(renderLocals);
+  viewLocals.push(locals).push(app.locals);
+
+  // a cached view has a known length, send it like any other body
+  if (file_ && !bodyData_ && app.viewCache.capacity() > 0 && viewEngine()) {
+    viewFingerprint_ = RenderCache::fingerprint(file_, viewLocals);
+    if (auto entry = app.viewCache.get(viewFingerprint_)) {
+      LOG_V(F("view cache hit"), entry->bytes.size());
+      bodyData_ = entry->bytes.data();
+      bodyLength_ = entry->bytes.size();
+      set(ContentLength, String(bodyLength_));
+    }
+  }
+
+  EXPRESS_TRACE_BEGIN(Headers);
+
+  // a replayed response counts its own headers, the client got those
+  auto written = out_.written;
 
   client.print(F("HTTP/1.1 "));
   client.println(status_);
 
   // Construct headers
-  evaluateHeaders(client);
+  evaluateHeaders(const_cast<ClientType &>(client_));
 
   LOG_V(F("Headers:"));
   for (auto [first, second] : headers)
     LOG_V(first, second);
 
   // Send headers
-  for (auto [first, second] : headers) {
+  for (auto &[first, second] : headers) {
     client.print(first);
     client.print(": ");
     client.println(second);
   }
+  for (auto &cookie : cookies_) {
+    client.print(F("Set-Cookie: "));
+    client.println(cookie);
+  }
   client.println();
 
   headersSent = true;
+  headerLength_ += out_.written - written;
+  EXPRESS_TRACE_END(Headers);
+
+  EXPRESS_TRACE_BEGIN(Body);
+  sendBody(client, viewLocals);
+
+  out_.flush();
+  EXPRESS_TRACE_END(Body);
+
+  finish();
+}
+
+/// @brief
+void _Response::flush() { out_.flush(); }
+
+/// @brief
+/// @param status
+/// @param data
+/// @param length
+/// @param headerLength
+void _Response::replay(const HttpStatus status, const uint8_t *data,
+                       const size_t length, const size_t headerLength) {
+  status_ = status;
+  headerLength_ = out_.written + headerLength;
+  out_.write(data, length);
+  out_.flush(); // before a capture mutes the client
+}
+
+/// @brief
+/// @param capture
+/// @param muted
+void _Response::capture(Print *capture, const bool muted) {
+  out_.tee(capture, muted);
+}
+
+/// @brief
+/// @param callback
+/// @return
+auto _Response::onFinish(const FinishCallback callback) -> bool {
+  if (finishCount_ == maxFinishCallbacks)
+    return false;
+
+  finish_[finishCount_++] = callback;
+  return true;
+}
+
+/// @brief runs the finish callbacks, once
+void _Response::finish() {
+  auto count = finishCount_;
+  finishCount_ = 0;
 
-  sendBody(client, renderLocals);
+  out_.tee(nullptr);
+  for (uint8_t i = 0; i < count; i++)
+    finish_[i](req, *this);
 }
 
 END_EXPRESS_NAMESPACE
@@ -23,13 +23,11 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define LOG_MODULE LOG_MODULE_ROUTER
 #include "Express.h"
 
 BEGIN_EXPRESS_NAMESPACE
 
-// static declarations
-bool _Router::gotoNext{};
-
 /// @brief Constructor
 _Router::_Router() { LOG_T(F("_Router contructor")); }
 
@@ -102,32 +100,16 @@ auto _Router::evaluate(_Request &req, _Response &res) -> bool {
   for (auto route : routes) {
     if ((route->method == Method::ALL || req.method_ == route->method) &&
         match(route->path, route->indices, req.uri, req_indices, req.params)) {
+      EXPRESS_TRACE_END(Match);
+      EXPRESS_TRACE_BEGIN(Route);
+
       res.status_ = HttpStatus::OK;
       req.route = route;
 
       // run the route wide middlewares
-      for (const auto middleware : route->middlewares) {
-        gotoNext = false;
-        try {
-          middleware(req, res, [gotoNext](const _Error *error) {
-            if (error) // reconstruct error message in new object
-              throw new _Error(error->message);
-            gotoNext = true;
-          });
-        } catch (_Error *error) {
-          res.status(HttpStatus::SERVER_ERROR);
-          for (const auto errorHandler : errorHandlers) {
-            errorHandler(*error, req, res,
-                         [gotoNext](const _Error *error) { gotoNext = true; });
-            if (!gotoNext)
-              break;
-          }
-          return false;
-        }
-        if (!gotoNext)
-          break;
-      }
+      run(route->middlewares, req, res);
 
+      EXPRESS_TRACE_END(Route);
       return true;
     }
   }
@@ -144,16 +126,122 @@ auto _Router::evaluate(_Request &req, _Response &res) -> bool {
 /// @brief
 auto _Router::dispatch(_Request &req, _Response &res) -> void {
   /// @brief run the _Router wide middlewares
-  gotoNext = true;
-  for (const auto middleware : middlewares) {
-    gotoNext = false;
-    middleware(req, res, [gotoNext](const _Error *error) { gotoNext = true; });
-    if (!gotoNext)
+  EXPRESS_TRACE_BEGIN(Middlewares);
+  auto done = run(middlewares, req, res, &middlewarePaths_);
+  EXPRESS_TRACE_END(Middlewares);
+
+  if (done) {
+    EXPRESS_TRACE_BEGIN(Match);
+    evaluate(req, res);
+    if (!req.route)
+      EXPRESS_TRACE_END(Match);
+  }
+}
+
+/// @brief
+/// @param error
+void _Next::operator()(const _Error *error) const {
+  if (!cursor_)
+    return;
+
+  auto &req = cursor_->req;
+  if (error) {
+    // an error handler passing on the error it was given
+    if (error != req.error_) {
+      strncpy(req.errorMessage_, error->message.c_str(),
+              sizeof(req.errorMessage_) - 1);
+      req.errorMessage_[sizeof(req.errorMessage_) - 1] = '\0';
+    }
+    req.failed_ = true;
+  }
+  cursor_->position = index_ + 1;
+}
+
+/// @brief
+/// @param chain
+/// @param req
+/// @param res
+/// @return
+auto _Router::run(const std::vector<MiddlewareCallback> &chain, _Request &req,
+                  _Response &res, const std::vector<String> *paths) -> bool {
+  _Cursor cursor{req, 0};
+  while (cursor.position < chain.size()) {
+    auto index = cursor.position;
+    if (paths && index < paths->size() && (*paths)[index].length() > 0) {
+      if (!mounted((*paths)[index], req.uri)) {
+        cursor.position++;
+        continue;
+      }
+      req.baseUrl = (*paths)[index];
+      call(chain[index], req, res, _Next(cursor, index));
+      req.baseUrl = F("");
+    } else
+      call(chain[index], req, res, _Next(cursor, index));
+    if (req.failed_) {
+      fail(req, res);
+      return false;
+    }
+    if (cursor.position == index) // next() was not called
+      return false;
+  }
+  return true;
+}
+
+/// @brief
+/// @param path
+/// @param uri
+/// @return
+auto _Router::mounted(const String &path, const String &uri) -> bool {
+  if (!uri.startsWith(path))
+    return false;
+  return uri.length() == path.length() || uri[path.length()] == '/';
+}
+
+/// @brief
+/// @param middleware
+/// @param req
+/// @param res
+/// @param next
+auto _Router::call(const MiddlewareCallback middleware, _Request &req,
+                   _Response &res, const _Next &next) -> void {
+#if defined(__cpp_exceptions)
+  try {
+    middleware(req, res, next);
+  } catch (_Error *error) { // throw new Error(...)
+    next(error);
+    delete error;
+  } catch (const _Error &error) {
+    next(&error);
+  }
+#else
+  middleware(req, res, next);
+#endif
+}
+
+/// @brief
+/// @param req
+/// @param res
+auto _Router::fail(_Request &req, _Response &res) -> void {
+  LOG_V(F("error:"), req.errorMessage_);
+
+  // only a failed request gets an _Error
+  _Error error(req.errorMessage_);
+  req.error_ = &error;
+
+  res.status(HttpStatus::SERVER_ERROR);
+  _Cursor cursor{req, 0};
+  while (cursor.position < errorHandlers.size()) {
+    auto index = cursor.position;
+    req.failed_ = false;
+    errorHandlers[index](error, req, res, _Next(cursor, index));
+    if (cursor.position == index)
       break;
+    if (req.failed_) // another error was passed on
+      error.message = req.errorMessage_;
   }
 
-  if (gotoNext)
-    evaluate(req, res);
+  req.error_ = nullptr;
+  req.failed_ = true;
 }
 
 /// @brief
@@ -236,7 +324,14 @@ auto _Router::use(const std::vector<MiddlewareCallback> middlewares)
 auto _Router::use(const String &path, const MiddlewareCallback middleware)
     -> void // TODO, args...
 {
-  // TODO
+  auto _path = path;
+  _path.trim();
+  while (_path.endsWith(F("/")))
+    _path.remove(_path.length() - 1); // "/" and "" run for every request
+
+  middlewarePaths_.resize(middlewares.size());
+  middlewarePaths_.push_back(_path);
+  middlewares.push_back(middleware);
 }
 
 /// @brief The app.mountpath property contains one or more path patterns on
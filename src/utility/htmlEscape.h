@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../defs.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief HTML escaping, used for {{name}} output of the mustache engine.
+///
+/// Text is scanned a machine word at a time (SWAR): a word without any of
+/// & < > " ' is skipped with a handful of ALU operations, clean runs are
+/// written with a single write. Only the unaligned head and the bytes around
+/// a special character take the byte by byte path.
+class HtmlEscape {
+private:
+  using Word = uintptr_t;
+
+  static constexpr Word ones = ~static_cast<Word>(0) / 0xFF; // 0x0101..
+  static constexpr Word highs = ones * 0x80;                 // 0x8080..
+
+  /// @brief non-zero when a byte of v is 0
+  static inline Word zeroByte(const Word v) { return (v - ones) & ~v; }
+
+  /// @brief non-zero when w contains one of & < > " '
+  static inline bool special(const Word w) {
+    // & (0x26) and ' (0x27) only differ in bit 0, < (0x3C) and > (0x3E) only
+    // in bit 1: three compares cover all five characters
+    return (zeroByte(w ^ (ones * '"')) |
+            zeroByte((w | ones * 0x01) ^ (ones * '\'')) |
+            zeroByte((w | ones * 0x02) ^ (ones * '>'))) &
+           highs;
+  }
+
+  /// @brief
+  /// @return the entity for c, or nullptr when c needs no escaping
+  static inline const char *entity(const char c, size_t &length) {
+    switch (c) {
+    case '&':
+      length = 5;
+      return "&amp;";
+    case '<':
+      length = 4;
+      return "&lt;";
+    case '>':
+      length = 4;
+      return "&gt;";
+    case '"':
+      length = 6;
+      return "&quot;";
+    case '\'':
+      length = 5;
+      return "&#39;";
+    default:
+      return nullptr;
+    }
+  }
+
+public:
+  /// @brief Writes str to out, replacing & < > " ' by their entities.
+  /// @param out
+  /// @param str
+  /// @param length
+  static void write(Print &out, const char *str, const size_t length) {
+    auto p = str;
+    auto run = str; // start of the clean run not yet written
+    auto end = str + length;
+
+    while (true) {
+      // skip clean words
+      while (reinterpret_cast<uintptr_t>(p) % sizeof(Word) == 0 &&
+             p + sizeof(Word) <= end) {
+        Word w;
+        memcpy(&w, p, sizeof(w)); // aligned, a single load
+        if (special(w))
+          break;
+        p += sizeof(Word);
+      }
+
+      if (p >= end)
+        break;
+
+      size_t entityLength;
+      if (auto escaped = entity(*p, entityLength)) {
+        if (p > run)
+          out.write(run, p - run);
+        out.write(escaped, entityLength);
+        run = p + 1;
+      }
+      p++;
+    }
+
+    if (end > run)
+      out.write(run, end - run);
+  }
+};
+
+END_EXPRESS_NAMESPACE
@@ -0,0 +1,229 @@
+/*!
+ *  @file       logger.cpp
+ *  Project     Arduino Express Library
+ *  @brief      Fast, unopinionated, (very) minimalist web framework for Arduino
+ *  @author     lathoub
+ *  @date       20/01/23
+ *  @license    GNU GENERAL PUBLIC LICENSE
+ *
+ *   Fast, unopinionated, (very) minimalist web framework for Arduino.
+ *   Copyright (C) 2023 lathoub
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "../defs.h"
+
+#if defined(LOG_LOGLEVEL) || defined(LOGGER)
+
+uint8_t Logger::levels[LOG_MODULES] = {
+    LOG_LOGLEVEL_VERBOSE, LOG_LOGLEVEL_VERBOSE, LOG_LOGLEVEL_VERBOSE,
+    LOG_LOGLEVEL_VERBOSE, LOG_LOGLEVEL_VERBOSE, LOG_LOGLEVEL_VERBOSE,
+};
+
+bool Logger::binary_ = LOG_BINARY;
+uint8_t Logger::ring_[LOG_BUFFER_SIZE];
+std::atomic<uint32_t> Logger::head_{0};
+std::atomic<uint32_t> Logger::tail_{0};
+std::atomic<uint32_t> Logger::dropped_{0};
+
+static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0,
+              "LOG_BUFFER_SIZE must be a power of 2");
+static_assert(LOG_BUFFER_SIZE >= Logger::Record::capacity,
+              "LOG_BUFFER_SIZE must hold at least one record");
+
+namespace {
+
+const uint32_t mask = LOG_BUFFER_SIZE - 1;
+
+const char fatal[] PROGMEM = "FATAL:   ";
+const char error[] PROGMEM = "ERROR:   ";
+const char warning[] PROGMEM = "Warning: ";
+const char info[] PROGMEM = "Info:    ";
+const char notice[] PROGMEM = "Notice:  ";
+const char trace[] PROGMEM = "trace:   ";
+const char verbose[] PROGMEM = "verbose: ";
+
+const char *const prefixes[] = {fatal,  error, warning, info,
+                                notice, trace, verbose};
+
+auto varint(const uint8_t *&p, const uint8_t *end) -> uint64_t {
+  uint64_t value = 0;
+  for (int shift = 0; p < end; shift += 7) {
+    auto byte = *p++;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      break;
+  }
+  return value;
+}
+
+/// @brief formats one record, the way LOG_PLAIN would have printed it
+void print(const uint8_t *data, size_t length) {
+  auto level = data[1];
+  if (level >= LOG_LOGLEVEL_FATAL && level <= LOG_LOGLEVEL_VERBOSE)
+    LOGGER.print(reinterpret_cast<const __FlashStringHelper *>(
+        prefixes[level - LOG_LOGLEVEL_FATAL]));
+
+  auto count = data[3];
+  auto p = data + Logger::Record::header;
+  auto end = data + length;
+  for (uint8_t i = 0; i < count && p < end; i++) {
+    if (i > 0)
+      LOGGER.print(' ');
+
+    switch (*p++) {
+    case Logger::Flash: {
+      const __FlashStringHelper *s;
+      memcpy(&s, p, sizeof s);
+      p += sizeof s;
+      LOGGER.print(s);
+      break;
+    }
+    case Logger::Text: {
+      auto n = *p++;
+      LOGGER.write(p, n);
+      p += n;
+      break;
+    }
+    case Logger::Signed: {
+      auto v = varint(p, end);
+      LOGGER.print(static_cast<long long>((v >> 1) ^ -(v & 1)));
+      break;
+    }
+    case Logger::Unsigned:
+      LOGGER.print(static_cast<unsigned long long>(varint(p, end)));
+      break;
+    case Logger::Float: {
+      double d;
+      memcpy(&d, p, sizeof d);
+      p += sizeof d;
+      LOGGER.print(d);
+      break;
+    }
+    case Logger::Char:
+      LOGGER.print(static_cast<char>(*p++));
+      break;
+    default:
+      p = end;
+    }
+  }
+  LOGGER.println();
+}
+
+/// @brief Sends one record as a frame: the arguments without the flash
+/// strings, the decoder has those in its table.
+void frame(const uint8_t *data, size_t length) {
+  uint8_t out[Logger::Record::capacity];
+  size_t n = 2;
+  memcpy(out + n, data + 4, 4); // site
+  n += 4;
+
+  auto count = data[3];
+  auto p = data + Logger::Record::header;
+  auto end = data + length;
+  for (uint8_t i = 0; i < count && p < end; i++) {
+    auto arg = p++;
+    switch (*arg) {
+    case Logger::Flash:
+      p += sizeof(const __FlashStringHelper *);
+      continue;
+    case Logger::Text:
+      p += 1 + *p;
+      break;
+    case Logger::Signed:
+    case Logger::Unsigned:
+      varint(p, end);
+      break;
+    case Logger::Float:
+      p += sizeof(double);
+      break;
+    case Logger::Char:
+      p++;
+      break;
+    default:
+      p = end;
+      continue;
+    }
+    memcpy(out + n, arg, p - arg);
+    n += p - arg;
+  }
+
+  out[0] = Logger::frameMarker;
+  out[1] = n - 2;
+  LOGGER.write(out, n);
+}
+
+} // namespace
+
+/// @brief
+/// @param record
+void Logger::commit(Record &record) {
+  record.data[0] = record.length;
+
+  auto head = head_.load(std::memory_order_relaxed);
+  auto tail = tail_.load(std::memory_order_acquire);
+  if (LOG_BUFFER_SIZE - (head - tail) < record.length) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  for (size_t i = 0; i < record.length; i++)
+    ring_[(head + i) & mask] = record.data[i];
+
+  head_.store(head + record.length, std::memory_order_release);
+}
+
+/// @brief
+/// @param max
+/// @return
+size_t Logger::flush(size_t max) {
+  size_t n = 0;
+  uint8_t data[Record::capacity];
+
+  auto tail = tail_.load(std::memory_order_relaxed);
+  while (n < max && tail != head_.load(std::memory_order_acquire)) {
+    size_t length = ring_[tail & mask];
+    for (size_t i = 0; i < length; i++)
+      data[i] = ring_[(tail + i) & mask];
+
+    tail += length;
+    tail_.store(tail, std::memory_order_release);
+
+    if (binary_)
+      frame(data, length);
+    else
+      print(data, length);
+    n++;
+  }
+
+  // after the records that made it into the ring, which came first
+  if (tail == head_.load(std::memory_order_acquire))
+    if (auto dropped = dropped_.exchange(0)) {
+      if (binary_) {
+        Record record(LOG_LOGLEVEL_WARNING, 0, 0);
+        put(record, dropped);
+        record.data[0] = record.length;
+        frame(record.data, record.length);
+        return n;
+      }
+      LOGGER.print(reinterpret_cast<const __FlashStringHelper *>(warning));
+      LOGGER.print(dropped);
+      LOGGER.println(F(" log records dropped"));
+    }
+
+  return n;
+}
+
+#endif
@@ -19,6 +19,344 @@
 
 #define LOG_SHORT_FILENAME (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : strrchr(__FILE__, '\\') ? strrchr(__FILE__, '\\') + 1 : __FILE__)
 
+// Modules have their own runtime level, see Logger::level(). A translation
+// unit logs as LOG_MODULE: define it before including the library.
+#define LOG_MODULE_APP 0
+#define LOG_MODULE_EXPRESS 1
+#define LOG_MODULE_REQUEST 2
+#define LOG_MODULE_RESPONSE 3
+#define LOG_MODULE_ROUTER 4
+#define LOG_MODULE_MIDDLEWARE 5
+#define LOG_MODULES 6
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_APP
+#endif
+
+// bytes of log records held until the next Logger::flush(), a power of 2
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 2048
+#endif
+
+// 1 to start in binary mode, see Logger::binary()
+#ifndef LOG_BINARY
+#define LOG_BINARY 0
+#endif
+
+#include <atomic>
+#include <type_traits>
+
+/// @brief Deferred logging. LOG_x() only checks the runtime level of its
+/// module (one compare) and, when enabled, copies its arguments in binary
+/// form into a ring buffer: flash strings by address, text by value, numbers
+/// as varints. Formatting and printing to LOGGER happens in flush(), which
+/// app.run() calls when no client is waiting. When the ring is full records
+/// are dropped, and counted, rather than holding up the request.
+///
+/// The ring has one producer (the task that handles requests) and one
+/// consumer (the one that flushes), it is lock-free between the two.
+///
+/// Levels above LOG_LOGLEVEL are not compiled in at all; the runtime level
+/// of every module starts at LOG_LOGLEVEL_VERBOSE, so everything compiled in
+/// is logged until lowered:
+///
+///     Logger::level(LOG_LOGLEVEL_WARNING);                      // all
+///     Logger::level(LOG_MODULE_REQUEST, LOG_LOGLEVEL_VERBOSE);  // one
+///
+/// In binary mode flush() does no formatting at all: every record goes out
+/// as a frame holding the ID of its call site and only the arguments that
+/// are not F() literals. extras/logdecode turns the frames back into text,
+/// using a table of call sites it generates from the sources:
+///
+///     frame  0xA5 length(1 byte) site(4 bytes, little endian) arguments
+///
+/// length counts the bytes after itself, arguments are encoded as in the
+/// ring. The site is a hash of the file name and line of the LOG_x() call,
+/// computed by the compiler (see site()); site 0 reports dropped records.
+/// A flash string that is not a literal in the call, eg F() ? F() : F(),
+/// can not be decoded: log those as text.
+class Logger
+{
+public:
+  enum Tag : uint8_t
+  {
+    Flash,    // address of a string in flash
+    Text,     // length (1 byte) and bytes
+    Signed,   // zigzag varint
+    Unsigned, // varint
+    Float,    // double
+    Char,
+  };
+
+  static const uint8_t frameMarker = 0xA5;
+
+  /// @brief Staging area of one record: length, level, module, argument
+  /// count, call site and arguments. Text that does not fit is cut.
+  class Record : public Print
+  {
+  public:
+    static const size_t capacity = 192;
+    static const size_t header = 8;
+
+    uint8_t data[capacity];
+    size_t length = header;
+
+    Record(uint8_t level, uint8_t module, uint32_t site)
+    {
+      data[1] = level;
+      data[2] = module;
+      data[3] = 0;
+      memcpy(data + 4, &site, sizeof site);
+    }
+
+    auto room() const -> size_t { return capacity - length; }
+
+    auto put(uint8_t byte) -> void
+    {
+      if (length < capacity)
+        data[length++] = byte;
+    }
+
+    auto put(const void *bytes, size_t n) -> void
+    {
+      if (n > room())
+        n = room();
+      memcpy(data + length, bytes, n);
+      length += n;
+    }
+
+    auto varint(uint64_t value) -> void
+    {
+      while (value >= 0x80)
+      {
+        put(uint8_t(value) | 0x80);
+        value >>= 7;
+      }
+      put(uint8_t(value));
+    }
+
+    /// @brief starts an argument, false when there is no room for it
+    auto begin(Tag tag, size_t size) -> bool
+    {
+      if (room() < 1 + size)
+        return false;
+      data[3]++;
+      put(tag);
+      return true;
+    }
+
+    auto text(const char *s, size_t n) -> void
+    {
+      if (!begin(Text, 1))
+        return;
+      if (n > room() - 1)
+        n = room() - 1;
+      if (n > 255)
+        n = 255;
+      put(uint8_t(n));
+      put(s, n);
+    }
+
+    // Print, for arguments that only know how to print themselves: the text
+    // goes into a Text argument opened by printed()
+    size_t write(uint8_t c) override
+    {
+      if (textLength_ == nullptr || *textLength_ == 255 || room() == 0)
+        return 0;
+      put(c);
+      (*textLength_)++;
+      return 1;
+    }
+
+    auto printed() -> uint8_t *
+    {
+      textLength_ = nullptr;
+      if (!begin(Text, 1))
+        return nullptr;
+      textLength_ = data + length;
+      put(uint8_t(0));
+      return textLength_;
+    }
+
+    auto done() -> void { textLength_ = nullptr; }
+
+  private:
+    uint8_t *textLength_ = nullptr;
+  };
+
+  static uint8_t levels[LOG_MODULES];
+
+  /// @brief
+  /// @return true when module logs at level
+  static bool enabled(uint8_t level, uint8_t module)
+  {
+    return level <= levels[module];
+  }
+
+  /// @brief Sets the runtime level of all modules.
+  static void level(uint8_t level)
+  {
+    for (auto &module : levels)
+      module = level;
+  }
+
+  /// @brief Sets the runtime level of one module.
+  static void level(uint8_t module, uint8_t level)
+  {
+    if (module < LOG_MODULES)
+      levels[module] = level;
+  }
+
+  /// @brief Sends records as binary frames rather than text, see above.
+  static void binary(bool on) { binary_ = on; }
+
+  /// @brief ID of a call site: FNV-1a of the file name (without directories),
+  /// ':' and the line as 4 bytes, little endian. Never 0.
+  /// @param file the path, length characters long
+  static constexpr uint32_t site(const char *file, size_t length,
+                                 uint32_t line)
+  {
+    return nonzero(
+        hashLine(hash(hash(file + basename(file, 0, length)), ':'), line));
+  }
+
+  template <typename... Args>
+  static void record(uint8_t level, uint8_t module, uint32_t site,
+                     const Args &...args)
+  {
+    Record record(level, module, site);
+    encode(record, args...);
+    commit(record);
+  }
+
+  /// @brief Formats and prints up to max records to LOGGER.
+  /// @return the number of records printed
+  static size_t flush(size_t max = SIZE_MAX);
+
+  /// @brief
+  /// @return records dropped because the ring was full, since the last flush
+  static uint32_t dropped() { return dropped_.load(); }
+
+  // arguments
+  static void put(Record &r, const __FlashStringHelper *s)
+  {
+    if (r.begin(Flash, sizeof s))
+      r.put(&s, sizeof s);
+  }
+  static void put(Record &r, const char *s) { r.text(s, s ? strlen(s) : 0); }
+  static void put(Record &r, const String &s) { r.text(s.c_str(), s.length()); }
+  static void put(Record &r, char c)
+  {
+    if (r.begin(Char, 1))
+      r.put(uint8_t(c));
+  }
+  static void put(Record &r, bool b)
+  {
+    if (r.begin(Unsigned, 1))
+      r.varint(b);
+  }
+  static void put(Record &r, double d)
+  {
+    if (r.begin(Float, sizeof d))
+      r.put(&d, sizeof d);
+  }
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value ||
+                                 std::is_enum<T>::value>::type
+  put(Record &r, T value)
+  {
+    if (std::is_signed<T>::value)
+    {
+      auto v = int64_t(value);
+      if (r.begin(Signed, 10))
+        r.varint((uint64_t(v) << 1) ^ uint64_t(v >> 63));
+    }
+    else if (r.begin(Unsigned, 10))
+      r.varint(uint64_t(value));
+  }
+  template <typename T>
+  static typename std::enable_if<std::is_class<T>::value>::type
+  put(Record &r, const T &value)
+  {
+    if (r.printed())
+      r.print(value);
+    r.done();
+  }
+
+private:
+  static bool binary_;
+  static uint8_t ring_[LOG_BUFFER_SIZE];
+  static std::atomic<uint32_t> head_; // written by the producer
+  static std::atomic<uint32_t> tail_; // written by the consumer
+  static std::atomic<uint32_t> dropped_;
+
+  static void encode(Record &) {}
+
+  template <typename T, typename... Args>
+  static void encode(Record &record, const T &head, const Args &...tail)
+  {
+    put(record, head);
+    encode(record, tail...);
+  }
+
+  static void commit(Record &record);
+
+  /// @brief where the file name in path [begin, end) starts: after its last
+  /// separator, 0 when there is none. Halves the range on every step, so
+  /// that long paths stay far below the constexpr recursion limit (C++11
+  /// constexpr functions cannot loop).
+  static constexpr auto basename(const char *path, size_t begin, size_t end)
+      -> size_t
+  {
+    return end - begin == 0 ? 0
+           : end - begin == 1
+               ? (path[begin] == '/' || path[begin] == '\\' ? begin + 1 : 0)
+               : either(basename(path, begin + (end - begin) / 2, end),
+                        basename(path, begin, begin + (end - begin) / 2));
+  }
+
+  static constexpr auto either(size_t a, size_t b) -> size_t
+  {
+    return a ? a : b;
+  }
+
+  /// @brief recurses once per character, only used on the file name
+  static constexpr auto hash(const char *s, uint32_t h = 2166136261u)
+      -> uint32_t
+  {
+    return *s == 0 ? h : hash(s + 1, (h ^ uint8_t(*s)) * 16777619u);
+  }
+
+  static constexpr auto hash(uint32_t h, uint32_t byte) -> uint32_t
+  {
+    return (h ^ byte) * 16777619u;
+  }
+
+  static constexpr auto hashLine(uint32_t h, uint32_t line) -> uint32_t
+  {
+    return hash(hash(hash(hash(h, line & 0xff), (line >> 8) & 0xff),
+                     (line >> 16) & 0xff),
+                line >> 24);
+  }
+
+  static constexpr auto nonzero(uint32_t h) -> uint32_t { return h ? h : 1; }
+};
+
+// a constant, also when optimizations are off
+#define LOG_SITE                                                             \
+  (std::integral_constant<uint32_t, Logger::site(__FILE__,                   \
+                                                 sizeof(__FILE__) - 1,       \
+                                                 __LINE__)>::value)
+
+#define LOG_RECORD(level, ...)                                  \
+  do                                                            \
+  {                                                             \
+    if (Logger::enabled(level, LOG_MODULE))                     \
+      Logger::record(level, LOG_MODULE, LOG_SITE, __VA_ARGS__); \
+  } while (0)
+
+#define LOG_FLUSH() Logger::flush()
+
 namespace
 {
 #if LOG_LOGLEVEL_IF(LOG_LOGLEVEL_FATAL)
@@ -26,7 +364,7 @@ namespace
   LOG_SETUP(unsigned long baud = 115200)
   {
     LOGGER.begin(baud);
-    while (!LOGGER && !LOGGER.available()) {} 
+    while (!LOGGER && !LOGGER.available()) {}
     LOGGER.println(F("\nStarting logging"));
   }
 #else
@@ -52,84 +390,49 @@ namespace
     LOG_PLAIN(tail...);
   }
 #endif
+} // namespace
 
 #if LOG_LOGLEVEL_IF(LOG_LOGLEVEL_FATAL)
-  template <typename... Args>
-  static void LOG_F(Args... args)
-  {
-    LOGGER.print(F("FATAL:   "));
-    LOG_PLAIN(args...);
-  }
+#define LOG_F(...) LOG_RECORD(LOG_LOGLEVEL_FATAL, __VA_ARGS__)
 #else
 #define LOG_F(...)
 #endif
 
 #if LOG_LOGLEVEL_IF(LOG_LOGLEVEL_ERROR)
-  template <typename... Args>
-  static void LOG_E(Args... args)
-  {
-    LOGGER.print(F("ERROR:   "));
-    LOG_PLAIN(args...);
-  }
+#define LOG_E(...) LOG_RECORD(LOG_LOGLEVEL_ERROR, __VA_ARGS__)
 #else
 #define LOG_E(...)
 #endif
 
 #if LOG_LOGLEVEL_IF(LOG_LOGLEVEL_WARNING)
-  template <typename... Args>
-  static void LOG_W(Args... args)
-  {
-    LOGGER.print(F("Warning: "));
-    LOG_PLAIN(args...);
-  }
+#define LOG_W(...) LOG_RECORD(LOG_LOGLEVEL_WARNING, __VA_ARGS__)
 #else
 #define LOG_W(...)
 #endif
 
 #if LOG_LOGLEVEL_IF(LOG_LOGLEVEL_INFO)
-  template <typename... Args>
-  static void LOG_I(Args... args)
-  {
-    LOGGER.print(F("Info:    "));
-    LOG_PLAIN(args...);
-  }
+#define LOG_I(...) LOG_RECORD(LOG_LOGLEVEL_INFO, __VA_ARGS__)
 #else
 #define LOG_I(...)
 #endif
 
 #if LOG_LOGLEVEL_IF(LOG_LOGLEVEL_NOTICE)
-  template <typename... Args>
-  static void LOG_N(Args... args)
-  {
-     LOGGER.print(F("Notice:  "));
-   LOG_PLAIN(args...);
-  }
+#define LOG_N(...) LOG_RECORD(LOG_LOGLEVEL_NOTICE, __VA_ARGS__)
 #else
 #define LOG_N(...)
 #endif
 
 #if LOG_LOGLEVEL_IF(LOG_LOGLEVEL_TRACE)
-  template <typename... Args>
-  static void LOG_T(Args... args)
-  {
-    LOGGER.print(F("trace:   "));
-    LOG_PLAIN(args...);
-  }
+#define LOG_T(...) LOG_RECORD(LOG_LOGLEVEL_TRACE, __VA_ARGS__)
 #else
 #define LOG_T(...)
 #endif
 
 #if LOG_LOGLEVEL_IF(LOG_LOGLEVEL_VERBOSE)
-  template <typename... Args>
-  static void LOG_V(Args... args)
-  {
-    LOGGER.print(F("verbose: "));
-    LOG_PLAIN(args...);
-  }
+#define LOG_V(...) LOG_RECORD(LOG_LOGLEVEL_VERBOSE, __VA_ARGS__)
 #else
 #define LOG_V(...)
 #endif
-} // namespace
 
 #else // LOGGER not defined
 #define LOG_SETUP(...)
@@ -141,4 +444,5 @@ namespace
 #define LOG_N(...)
 #define LOG_T(...)
 #define LOG_V(...)
-#endif
\ No newline at end of file
+#define LOG_FLUSH()
+#endif